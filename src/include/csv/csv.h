@@ -23,6 +23,14 @@ using VoidableTable = std::vector<VoidableRow>;
  */
 VoidableTable read_csv(std::istream& input);
 
+/**
+ * @brief Parse a single line of CSV data
+ * @param line line without the terminating newline
+ * @return Parsed row
+ * @throws ParsingError on invalid format
+ */
+VoidableRow parse_csv_line(const std::string& line);
+
 /**
  * @brief Write CSV a stream
  * @param output stream
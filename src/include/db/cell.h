@@ -55,6 +55,12 @@ public:
      */
     static std::pair<Cell, Cell> promote_to_common(const Cell& left, const Cell& right);
     
+    /**
+     * @brief Convert cell to a different data type
+       @return A the converted cell
+     */
+    Cell convert(DataType target_type) const;
+    
     Cell operator+(const Cell& other) const;
     Cell operator-(const Cell& other) const;
     Cell operator*(const Cell& other) const;
@@ -114,7 +120,16 @@ public:
      * @return String representation or `std::nullopt` for Null
      */
     std::optional<std::string> repr() const;
-    
+
+    /**
+     * @brief Get the stored value if it is of type T
+     * @return Pointer to the value or `nullptr` if the cell holds a different type
+     */
+    template<class T>
+    const T* get_if() const {
+        return std::get_if<T>(&data);
+    }
+
     /**
      * @brief Check if two cells are identical
             Checks on identity, different types are not identical
@@ -175,12 +190,6 @@ private:
         return result;
     }
 
-    /**
-     * @brief Convert cell to a different data type
-       @return A the converted cell
-     */
-    Cell convert(DataType target_type) const;
-    
     Cell convert_to_string() const;
     Cell convert_to_int() const;
     Cell convert_to_float() const;
@@ -193,7 +202,7 @@ private:
 
 template<>
 struct std::hash<Cell>{
-    size_t operator()(const Cell& cell){
+    size_t operator()(const Cell& cell) const {
         return std::hash<decltype(cell.data)>()(cell.data);
     }
 };
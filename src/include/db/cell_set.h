@@ -0,0 +1,114 @@
+#ifndef CELL_SET_H
+#define CELL_SET_H
+
+#include "db/table.h"
+
+#include <optional>
+#include <string>
+#include <unordered_set>
+#include <variant>
+#include <vector>
+
+/**
+ * @brief Set of cells for repeated membership tests
+ * @details Membership follows `Cell::operator==`, NULL is never contained.
+            Sets consisting only of INT or only of STRING values are stored in
+            a typed hash set, other sets are scanned linearly.
+ */
+class CellSet{
+public:
+    /**
+     * @brief Build the set from a list of values
+     */
+    explicit CellSet(std::vector<Cell> values);
+    
+    /**
+     * @brief Check if a value equals to any member of the set
+     */
+    bool contains(const Cell& value) const;
+    
+    /**
+     * @brief Check membership for each value of a column
+     */
+    BoolVector contains(const CellVector& values) const;
+    
+private:
+    /**
+     * @brief Non-NULL members of the set
+     */
+    std::vector<Cell> values;
+    
+    std::variant<std::monostate, std::unordered_set<int>, std::unordered_set<std::string>> typed_values;
+    
+    /**
+     * @brief Build the typed hash set if all members have type T
+     */
+    template<class T>
+    bool try_build_typed();
+    
+    /**
+     * @brief Check membership by comparing with every member
+     */
+    bool contains_generic(const Cell& value) const;
+    
+    /**
+     * @brief Check membership using the typed hash set
+     */
+    template<class T>
+    bool contains_typed(const std::unordered_set<T>& set, const Cell& value) const;
+    
+    bool contains_typed(const std::monostate& set, const Cell& value) const;
+};
+
+/**
+ * @brief Identity comparison for Cell
+ */
+struct CellIdentical{
+    bool operator()(const Cell& a, const Cell& b) const {
+        return Cell::is_identical(a, b);
+    }
+};
+
+/**
+ * @brief Distinct values collected one at a time, for aggregates with DISTINCT
+ * @details Values are distinct by `Cell::is_identical`, so NULL is a single value.
+            While all the values are INT, FLOAT or STRING of the same type, they are looked up in
+            a typed hash set, afterwards in a hash set of cells.
+ */
+class DistinctValues{
+public:
+    /**
+     * @brief Add a value
+     * @return True if the value wasn't contained yet
+     */
+    bool insert(const Cell& value);
+
+    /**
+     * @brief Get the number of the distinct values
+     */
+    size_t size() const { return values.size(); }
+
+    /**
+     * @brief Get the distinct values in the order they were first inserted
+     */
+    const std::vector<Cell>& get_values() const { return values; }
+
+private:
+    std::vector<Cell> values;
+
+    std::variant<std::monostate, std::unordered_set<int>, std::unordered_set<float>, std::unordered_set<std::string>,
+        std::unordered_set<Cell, std::hash<Cell>, CellIdentical>> index;
+
+    /**
+     * @brief Insert a value into the typed hash set
+     * @return True if inserted, false if contained, `std::nullopt` if the value has another type
+     */
+    template<class T>
+    static std::optional<bool> insert_typed(std::unordered_set<T>& set, const Cell& value);
+
+    static std::optional<bool> insert_typed(std::monostate& set, const Cell& value);
+
+    static std::optional<bool> insert_typed(std::unordered_set<Cell, std::hash<Cell>, CellIdentical>& set, const Cell& value);
+};
+
+#endif
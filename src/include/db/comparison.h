@@ -0,0 +1,72 @@
+#ifndef COMPARISON_H
+#define COMPARISON_H
+
+#include "db/table.h"
+#include "parse/token_stream.h"
+
+#include <vector>
+
+/**
+ * @brief Comparison operator of a condition
+ */
+enum class ComparisonOperator{
+    Less,
+    Equal,
+    Greater,
+    LessEqual,
+    GreaterEqual,
+    NotEqual
+};
+
+/**
+ * @brief Convert operator token to comparison operator
+ * @throws InvalidQuery if the token is not a valid operator
+ */
+ComparisonOperator token_to_comparison_operator(const Token& token);
+
+/**
+ * @brief Compare two cells
+ * @details Same semantics as the comparison operators of Cell
+ */
+bool compare_cells(ComparisonOperator op, const Cell& left, const Cell& right);
+
+/**
+ * @brief Compare two columns row by row
+ * @details The types of the columns are inspected once and the comparison
+            is dispatched to a loop specialized for them
+ * @param selection Output bitmap, resized to the column size
+ * @param intersect If true, only rows already set in `selection` can stay set
+ */
+void compare_columns(ComparisonOperator op, const CellVector& left, const CellVector& right,
+    BoolVector& selection, bool intersect = false);
+
+/**
+ * @brief Compare two columns row by row
+ * @return Result of the comparison for each row
+ */
+BoolVector compare_columns(ComparisonOperator op, const CellVector& left, const CellVector& right);
+
+/**
+ * @brief Evaluate `lower <= value AND value <= upper` for each row
+ */
+BoolVector between_columns(const CellVector& value, const CellVector& lower, const CellVector& upper);
+
+/**
+ * @brief Compare each value with the corresponding list using ANY or ALL
+ * @param values Left side of the comparison for each row
+ * @param lists Right side values for each row
+ * @param any True for ANY, false for ALL
+ */
+BoolVector compare_quantified(ComparisonOperator op, const CellVector& values,
+    const std::vector<std::vector<Cell>>& lists, bool any);
+
+/**
+ * @brief Compare each value with the same list using ANY or ALL
+ * @param values Left side of the comparison for each row
+ * @param list Right side values shared by all rows
+ * @param any True for ANY, false for ALL
+ */
+BoolVector compare_quantified(ComparisonOperator op, const CellVector& values,
+    const std::vector<Cell>& list, bool any);
+
+#endif
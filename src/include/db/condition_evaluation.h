@@ -3,6 +3,8 @@
 
 #include "db/table.h"
 #include "db/variable_list.h"
+#include "db/comparison.h"
+#include "db/subquery.h"
 
 #include <vector>
 #include <functional>
@@ -19,10 +21,12 @@ public:
      * @param stream TokenStream containing the condition tokens
      * @param variables Variable bindings for the evaluation
      * @param select_callback Callback for evaluating subqueries
+     * @param subquery_caches If not null, results of the subqueries shared with other evaluations of the condition
      */
     ConditionEvaluation(const Table& table, TokenStream& stream, const VariableList& variables, 
-        std::function<Table(TokenStream&, const VariableList&)>& select_callback) : 
-            table(table), stream(stream), variables(variables), select_callback(select_callback) {}
+        SelectCallback& select_callback, SubqueryCaches* subquery_caches = nullptr) : 
+            table(table), stream(stream), variables(variables), select_callback(select_callback),
+            subquery_caches(subquery_caches) {}
         
     /**
      * @brief Evaluate the condition
@@ -33,11 +37,9 @@ private:
     const Table& table;
     TokenStream& stream;
     const VariableList& variables;
-    std::function<Table(TokenStream&, const VariableList&)>& select_callback;
+    SelectCallback& select_callback;
+    SubqueryCaches* subquery_caches;
     
-    template<class T>
-    using Comparator = std::function<bool(const T&, const T&)>;
-        
     /**
      * @brief Evaluate a conjunctive condition (AND)
      * @return BoolVector of the result of the condition for each row
@@ -112,45 +114,38 @@ private:
     /**
      * @brief Evaluate comparison with subquery
      * @param expression Expression to compare with subquery results
-     * @param comparator Comparator to use
+     * @param op Comparison operator to use
      * @param has_any Whether ANY is present
      * @param has_all Whether ALL is present
      * @return BoolVector of the result of the condition for each row
      */
-    BoolVector evaluate_compare_subquery(CellVector expression, Comparator<Cell> comparator, bool has_any, bool has_all);
-    
-    /**
-     * @brief Convert operator token to comparison function
-     * @throws InvalidQuery if the token is not a valid operator
-     */
-    static Comparator<Cell> operator_token_to_comparator(const Token& token);
+    BoolVector evaluate_compare_subquery(CellVector expression, ComparisonOperator op, bool has_any, bool has_all);
     
     /**
-     * @brief Process a SELECT statement for a single row
-     * @param statement The SELECT statement
-     * @param extra_vars Additional variables for the query
-     * @return Result table from the SELECT
+     * @brief Read a subquery up to the closing bracket
+     * @details The bracket is not consumed
      */
-    Table process_select_single_row(const std::string& statement, const BoundRow& extra_vars);
+    Subquery read_subquery();
     
     /**
-     * @brief Evaluate a SELECT subquery (for each row)
-     * @return Vector of result tables
+     * @brief Evaluate IN with a subquery, as a semi-join if possible
+     * @param expression values to check for membership
+     * @return BoolVector of the result of the condition for each row
      */
-    std::vector<Table> process_select();
+    BoolVector evaluate_in_subquery(const CellVector& expression, const Subquery& subquery);
     
     /**
-     * @brief Evaluate a subquery for each row that only returns a single cell table
+     * @brief Extract the results of a subquery that only returns single cell tables
      * @return A single cell for each row
      * @throws InvalidQuery if the subquery returns more than one cell
      */
-    CellVector process_select_singles();
+    CellVector process_select_singles(const SubqueryResults& select_result);
     
     /**
-     * @brief Process subqueries returning single columns
+     * @brief Extract the results of a subquery returning single columns
      * @return Vector of column returned from each query
      */
-    std::vector<std::vector<Cell>> process_select_vectors();
+    std::vector<std::vector<Cell>> process_select_vectors(const SubqueryResults& select_result);
     
     /**
      * @brief Extract a single cell from a table
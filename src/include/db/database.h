@@ -2,7 +2,12 @@
 #define DATABASE_H
 
 #include "db/table.h"
+#include "db/execution_settings.h"
+#include "db/hash_aggregate.h"
+#include "db/join.h"
+#include "db/query_plan.h"
 #include "parse/token_stream.h"
+#include "parse/select_clauses.h"
 
 #include <string>
 #include <map>
@@ -29,6 +34,14 @@ public:
      */
     std::string process_query(const std::string& query) noexcept;
     
+    /**
+     * @brief Set the limits of the query execution
+     * @details Must not be called while queries are being processed
+     */
+    void set_settings(const ExecutionSettings& new_settings) { settings = new_settings; }
+    
+    const ExecutionSettings& get_settings() const { return settings; }
+    
     class Accessor{
     private:
         Accessor() = default;
@@ -69,24 +82,81 @@ private:
      */
     std::string process_query_make_stream(const std::string& query);
     
+    /**
+     * @brief Measurements of the operators of a SELECT statement applied after the joins
+     */
+    struct SelectStatistics{
+        OperatorStatistics where;
+        OperatorStatistics group;
+        OperatorStatistics having;
+        OperatorStatistics project;
+        OperatorStatistics distinct;
+        OperatorStatistics sort;
+        bool external_sort = false;     /**< The sorted rows were written to temporary files */
+        SubqueryStatistics where_subqueries;
+        SubqueryStatistics having_subqueries;
+        SubqueryStatistics project_subqueries;
+    };
+
     /**
      * @brief Evaluate a SELECT statement
+     * @param mode Part of the result that is needed
+     * @param plan If not null, set to the executed plan with the measurements of the operators
      * @return Table resulting from the statement
      */
-    Table evaluate_select(TokenStream& stream, const VariableList& variables);
+    Table evaluate_select(TokenStream& stream, const VariableList& variables, SelectMode mode, PlanNode* plan);
+
+    /**
+     * @brief Build the plan of a SELECT statement
+     * @param planner Planner of the joins of the statement
+     * @param residual The part of the WHERE condition applied after the joins
+     * @param statistics Measurements of the operators, without rows for a statement that wasn't executed
+     */
+    static PlanNode describe_select(const SelectClauses& clauses, const JoinPlanner& planner, const std::string& residual,
+        const SelectStatistics& statistics);
+    
+    /**
+     * @brief Find out if a SELECT statement returns a row when the tables are just a cross product
+     * @details The cross product is generated and filtered in growing chunks
+                until a row passes the WHERE condition
+     * @return Unprojected table, empty if the statement returns no rows
+     */
+    Table evaluate_select_first_row(const std::vector<std::pair<const Table&, std::string>>& taken_tables,
+        const std::string& condition, const VariableList& variables);
+    
+    /**
+     * @brief Find out if a SELECT statement returns a row when the tables are joined or filtered
+     * @details The batches of the joined rows are filtered by the rest of the WHERE condition
+                until one of them has a row left. Nothing is projected, deduplicated or sorted
+     * @return Unprojected table, empty if the statement returns no rows
+     */
+    Table evaluate_select_first_batch(JoinPlanner& planner, const VariableList& variables);
+    
+    /**
+     * @brief Filter a table by a condition if there is one
+     * @param condition The condition or an empty string
+     * @param callback Callback for evaluating subqueries
+     * @param subquery_caches If not null, results of the subqueries shared with other evaluations of the condition
+     */
+    void filter_by_where(Table& table, const std::string& condition, const VariableList& variables, SelectCallback& callback,
+        SubqueryCaches* subquery_caches = nullptr);
     
     /**
      * @brief Process the GROUP BY and HAVING clauses
-     * @param table The table to be grouped
-     * @return A table for each of the resulting groups
+     * @param aggregate The aggregate the filtered rows were added to
+     * @param callback Callback for evaluating subqueries
+     * @param statistics Receives the measurements of the grouping and the HAVING condition
+     * @return The table of the resulting groups, see **HashAggregate**
      */
-    std::vector<Table> evaluate_select_group(TokenStream& stream, const VariableList& variables, Table& table);
+    Table evaluate_select_group(const SelectClauses& clauses, const VariableList& variables, HashAggregate& aggregate,
+        SelectCallback& callback, SelectStatistics& statistics);
     
     /**
-     * @brief Read tables referenced in a SELECT statement
+     * @brief Look up tables referenced in a SELECT statement
      * @return Pairs of the table and the alias
+     * @throws InvalidQuery if a table doesn't exist
      */
-    std::vector<std::pair<const Table&, std::string>> read_selected_tables(TokenStream& stream);
+    std::vector<std::pair<const Table&, std::string>> get_selected_tables(const std::vector<TableReference>& references);
     
     /**
      * @brief Process a CREATE TABLE statement
@@ -109,6 +179,15 @@ private:
      */
     std::string process_select(TokenStream& stream);
     
+    /**
+     * @brief Process an EXPLAIN [ANALYZE] statement
+     * @details The plan is returned as a table with a row for each operator. Without ANALYZE the statement
+                isn't executed, except for the conditions of single tables applied while planning the joins
+     * @param stream The query
+     * @return Response to the query
+     */
+    std::string process_explain(TokenStream& stream);
+    
     /**
      * @brief Process an INSERT statement
      * @param stream The query
@@ -125,14 +204,26 @@ private:
     
     std::map<std::string, Table> tables;
     
+    ExecutionSettings settings;
+    
     /**
      * @brief Callback for SELECT subquery evaluation
      */
-    std::function<Table(TokenStream&, const VariableList&)> select_callback = 
-        [this](TokenStream& stream, const VariableList& variables){
-        return this->evaluate_select(stream, variables);
+    SelectCallback select_callback = 
+        [this](TokenStream& stream, const VariableList& variables, SelectMode mode){
+        return this->evaluate_select(stream, variables, mode, nullptr);
     };
     
+    /**
+     * @brief Number of rows of the first chunk in the first row mode
+     */
+    static constexpr size_t first_row_min_chunk = 16;
+    
+    /**
+     * @brief Maximal number of rows of a chunk in the first row mode
+     */
+    static constexpr size_t first_row_max_chunk = 4096;
+    
     /**
      * @brief Shared mutex for table access
      * @details Protects the structure of the tables map but not the tables themselves
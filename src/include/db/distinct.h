@@ -0,0 +1,109 @@
+#ifndef DISTINCT_H
+#define DISTINCT_H
+
+#include "db/execution_settings.h"
+#include "db/table.h"
+#include "helper/row_container.h"
+
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <unordered_set>
+#include <vector>
+
+/**
+ * @brief Removes repeated rows from a stream of batches, keeping the first occurrence of each row
+ * @details Each row is passed on as soon as it is seen for the first time, so the rows keep their order
+            and the result is produced while the batches are coming. The rows seen so far are kept in
+            hash sets, one for each partition of the rows by their hash.
+
+            When the sets exceed the memory budget, the largest partition is written to a temporary file.
+            Later rows of that partition can't be decided until the end, they are written to another file
+            together with their position. `finish` goes through the spilled partitions one at a time and
+            puts the rows seen for the first time among the passed rows by their positions.
+ */
+class DistinctFilter{
+public:
+    /**
+     * @param settings Limits of the execution
+     */
+    explicit DistinctFilter(const ExecutionSettings& settings);
+
+    /**
+     * @brief Pass on the rows of a batch seen for the first time
+     * @details The batches must be added in the order of their rows
+     * @return The rows that are known to be seen for the first time, in their order
+     * @throws std::runtime_error if a temporary file can't be written
+     */
+    Table add(Table batch);
+
+    /**
+     * @brief Add the rows of the spilled partitions seen for the first time
+     * @param passed All the rows returned by `add` in their order, receives the other rows
+     * @throws std::runtime_error if a temporary file can't be read
+     */
+    void finish(Table& passed);
+
+    /**
+     * @brief Number of the partitions of the rows
+     */
+    static constexpr size_t partition_count = 16;
+
+private:
+    /**
+     * @brief Temporary file with rows and their positions
+     * @details The type of each cell is stored with it. The file is removed with the object
+     */
+    class SpillFile{
+    public:
+        explicit SpillFile(const std::filesystem::path& directory);
+
+        ~SpillFile();
+
+        SpillFile(const SpillFile&) = delete;
+
+        SpillFile& operator=(const SpillFile&) = delete;
+
+        void write(size_t position, const TableRow& row);
+
+        /**
+         * @brief Read the rows back in the order they were written
+         * @return Pairs (position, row)
+         */
+        std::vector<std::pair<size_t, TableRow>> read();
+
+    private:
+        std::filesystem::path path;
+        std::ofstream file;
+    };
+
+    struct Partition{
+        std::unordered_set<TableRow, TableRowHash, TableRowIdentical> rows;     /**< Rows seen so far, unless spilled */
+        size_t bytes = 0;                   /**< Estimated size of `rows` */
+        std::optional<SpillFile> seen;      /**< Rows seen before the partition was spilled */
+        std::optional<SpillFile> pending;   /**< Rows coming after the partition was spilled */
+    };
+
+    ExecutionSettings settings;
+
+    std::vector<Partition> partitions;
+    size_t memory = 0;                      /**< Estimated size of the sets in memory */
+
+    size_t position = 0;                    /**< Number of the rows added so far */
+    size_t passed_count = 0;                /**< Number of the rows passed on so far */
+
+    std::optional<size_t> passed_before_spill;  /**< Number of the rows passed on before the first spill */
+    std::vector<size_t> passed_positions;       /**< Positions of the rows passed on after the first spill */
+
+    /**
+     * @brief Write the set of a partition to a file and free it
+     */
+    void spill(size_t partition);
+
+    /**
+     * @brief Estimate the memory a row takes in a set
+     */
+    static size_t estimate_row_bytes(const TableRow& row);
+};
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef EXECUTION_SETTINGS_H
+#define EXECUTION_SETTINGS_H
+
+#include <cstddef>
+#include <filesystem>
+
+/**
+ * @brief Limits of the query execution
+ */
+struct ExecutionSettings{
+    /**
+     * @brief Number of bytes an operator may use for its own structures
+     * @details Operators exceeding it switch to an algorithm needing less memory
+     */
+    size_t memory_budget = 64 << 20;
+
+    /**
+     * @brief Directory for the temporary files of operators exceeding the memory budget
+     * @details The system temporary directory is used if empty
+     */
+    std::filesystem::path spill_directory;
+
+    /**
+     * @brief Number of rows passed between the stages of a query at once
+     * @details Only the operators that need all their input, like grouping, keep more rows
+     */
+    size_t batch_rows = 4096;
+
+    /**
+     * @brief Number of bytes of the cache of a core
+     * @details Hash tables built in parallel are partitioned so that each partition fits into it
+     */
+    size_t cache_bytes = 1 << 20;
+};
+
+#endif
@@ -25,6 +25,12 @@ public:
      */
     EvaluatedExpression evaluate();
     
+    /**
+     * @brief Parse the expression into a tree evaluated for each row
+     * @details Aggregates are computed over the table already when parsing
+     */
+    std::unique_ptr<ExpressionNode> parse();
+    
 private:
     const Table& table;
     TokenStream& stream;      /**< Token stream containing the expression */
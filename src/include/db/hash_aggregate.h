@@ -0,0 +1,176 @@
+#ifndef HASH_AGGREGATE_H
+#define HASH_AGGREGATE_H
+
+#include "db/cell_set.h"
+#include "db/execution_settings.h"
+#include "db/expression.h"
+#include "db/table.h"
+#include "db/variable_list.h"
+#include "helper/row_container.h"
+#include "parse/token_stream.h"
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Groups rows and computes the aggregate functions of each group in a single pass
+ * @details The calls of COUNT, SUM, AVG, MIN and MAX in the expressions evaluated on the groups are collected
+            and each group keeps an accumulator for each call, updated as the rows are added. Of the rows themselves
+            only the first row of each group is kept, which provides the values of the other columns.
+
+            The rows are added in morsels, which may be aggregated by several threads at once. Each morsel is
+            first aggregated on its own. The groups of all the morsels are then split into partitions by the hashes
+            of their keys, small enough for the hash table of a partition to stay in the cache, and the partitions
+            are merged in parallel on the shared **WorkerPool**.
+
+            The result is a table with a row for each group: the first row of the group followed by the value of each
+            call. `rewrite` replaces the calls in an expression by the names of these columns, so the expression
+            can be evaluated on the table like on any other one.
+ */
+class HashAggregate{
+public:
+    /**
+     * @param header Header of the aggregated rows
+     * @param group_by Grouping columns, empty to aggregate all the rows into a single group
+     * @param expressions Expressions and conditions that will be evaluated on the groups
+     * @param variables Variable bindings of the enclosing query
+     * @param settings Limits of the execution
+     * @throws InvalidQuery if a column doesn't exist or a call is malformed
+     */
+    HashAggregate(TableHeader header, const std::vector<std::string>& group_by,
+        const std::vector<std::string>& expressions, const VariableList& variables, const ExecutionSettings& settings);
+
+    /**
+     * @brief Aggregate a morsel of rows
+     * @details The rows must have the header given to the constructor. Can be called by several threads at once
+     * @param morsel Index of the morsel, giving the order of the rows
+     */
+    void add(size_t morsel, const Table& rows);
+
+    /**
+     * @brief Get the table of the groups in the order of their first rows
+     * @details Merges the groups of the added morsels, no more rows can be added afterwards
+     */
+    Table get_groups();
+
+    /**
+     * @brief Get the header of the aggregated rows
+     */
+    const TableHeader& get_header() const { return header; }
+
+    /**
+     * @brief Replace the aggregate calls in an expression by the columns of the table of the groups
+     * @details Calls inside subqueries belong to the subqueries and are kept
+     */
+    std::string rewrite(const std::string& expression) const;
+
+    /**
+     * @brief Largest number of partitions the groups are merged in
+     */
+    static constexpr size_t max_partitions = 1024;
+
+private:
+    enum class Function{
+        CountAll,
+        Count,
+        Sum,
+        Avg,
+        Min,
+        Max
+    };
+
+    /**
+     * @brief An aggregate call found in the expressions
+     */
+    struct Call{
+        Function function;
+        bool distinct;
+        size_t column;                              /**< Argument of COUNT */
+        std::shared_ptr<ExpressionNode> argument;   /**< Argument of the other functions */
+        Cell::DataType type;                        /**< Type of the result */
+    };
+
+    /**
+     * @brief State of a call for one group
+     */
+    struct Accumulator{
+        size_t count = 0;                   /**< Number of the accumulated (distinct) values */
+        std::optional<Cell> value;          /**< Sum, minimum or maximum of the (distinct) values */
+        DistinctValues distinct_values;     /**< Accumulated values of a DISTINCT call */
+    };
+
+    struct Group{
+        TableRow key;
+        size_t hash;                            /**< Hash of the key */
+        std::pair<size_t, size_t> origin;       /**< Morsel and row of the first row */
+        TableRow first_row;
+        std::vector<Accumulator> accumulators;  /**< For each call */
+    };
+
+    TableHeader header;
+    const VariableList& variables;
+    ExecutionSettings settings;
+
+    std::vector<size_t> group_columns;
+
+    std::vector<Call> calls;
+    std::map<std::string, size_t> call_ids;     /**< Index of the call for the text of the call */
+
+    std::mutex mutex;
+    std::map<size_t, std::vector<Group>> morsel_groups;     /**< Groups of each added morsel */
+
+    /**
+     * @brief Call `callback(begin, end)` with the token range of each aggregate call outside subqueries
+     * @details `end` is the index after the closing bracket
+     */
+    static void for_each_call(const std::vector<Token>& tokens, const std::function<void(size_t, size_t)>& callback);
+
+    /**
+     * @brief Parse the arguments of a call
+     */
+    Call parse_call(const std::vector<Token>& tokens) const;
+
+    /**
+     * @brief Get the name of the column with the value of a call
+     */
+    static std::string get_column_name(size_t call);
+
+    /**
+     * @brief Choose the number of partitions so that the hash table of a partition fits into the cache
+     * @param group_count Number of the groups of all the morsels
+     */
+    size_t get_partition_count(size_t group_count) const;
+
+    /**
+     * @brief Merge the groups of the morsels
+     * @return The groups in the order of their first rows
+     */
+    std::vector<Group> merge_groups();
+
+    /**
+     * @brief Add a value to an accumulator
+     */
+    static void accumulate(const Call& call, Accumulator& accumulator, const Cell& value);
+
+    /**
+     * @brief Add the values of an accumulator of a later morsel to another one
+     */
+    static void merge(const Call& call, Accumulator& target, Accumulator&& source);
+
+    /**
+     * @brief Combine a sum, a minimum or a maximum with another value
+     */
+    static void combine(Function function, std::optional<Cell>& target, const Cell& value);
+
+    /**
+     * @brief Get the value of a call from its accumulator
+     */
+    static Cell finalize(const Call& call, const Accumulator& accumulator);
+};
+
+#endif
@@ -0,0 +1,373 @@
+#ifndef JOIN_H
+#define JOIN_H
+
+#include "db/table.h"
+#include "db/variable_list.h"
+#include "db/execution_settings.h"
+#include "db/join_algorithms.h"
+#include "db/query_plan.h"
+#include "parse/token_stream.h"
+
+#include <atomic>
+#include <functional>
+#include <optional>
+#include <set>
+#include <string>
+#include <variant>
+#include <vector>
+
+/**
+ * @brief Receives the rows produced by a stage of a query a batch at a time
+ * @details Called with the index of the batch and its rows. The batches may be processed by several
+            threads at once and in any order, their indexes give the order of the rows
+ */
+using BatchConsumer = std::function<void(size_t, Table)>;
+
+/**
+ * @brief Combines the tables of a FROM clause using the conditions of the WHERE clause
+ * @details Equalities between columns of two different tables and `BETWEEN` with the value
+            and the bounds in different tables are executed as joins instead of filtering
+            the full cross product. Other conditions referring to exactly two tables are
+            evaluated by a block nested-loop join. Tables not connected by any of them are
+            combined by a cross product. Conditions referring to a single table filter its rows
+            before they are combined. The other conditions are applied afterwards.
+
+            A small group of tables is joined with a whole table by looking up the matching
+            rows in an index of the table, which is kept by the table for the next queries.
+
+            The order of the joins is chosen to keep the estimated sizes of the intermediate
+            results small. The sizes are estimated from the row counts of the filtered tables
+            and the numbers of distinct values in the join columns. A table keeps the numbers
+            for its columns with its indexes. They aren't counted for two connected tables,
+            which can be joined in only one way, unless the plan is described. A planner that
+            only describes the plan doesn't read the rows of the tables at all. It estimates the
+            size of a filtered table as a fixed part of its rows and an equality as a join on a key.
+
+            Only the columns the statement refers to are copied from the tables. The joins work
+            with the indexes of the matching rows and the rows are put together only at the end,
+            in batches passed to the next stage, so the whole result is never stored at once.
+ */
+class JoinPlanner{
+public:
+    /**
+     * @param tables Pairs of the table and the alias in the FROM order
+     * @param condition The WHERE condition, empty if not present
+     * @param referenced_names Names the statement refers to columns by, `std::nullopt` to keep all columns
+     * @param variables Variable bindings of the enclosing query
+     * @param select_callback Callback for evaluating subqueries
+     * @param settings Limits of the execution
+     * @param plan_only Only plan the joins for `get_plan`, estimating from the row counts of the tables
+                        without reading their rows. The planner can't be executed then
+     * @details The conditions of single tables are applied already here
+     */
+    JoinPlanner(std::vector<std::pair<const Table&, std::string>> tables, const std::vector<Token>& condition,
+        const std::optional<std::set<std::string>>& referenced_names, const VariableList& variables, SelectCallback& select_callback,
+        const ExecutionSettings& settings, bool plan_only = false);
+
+    /**
+     * @brief Check if the plan avoids filtering the full cross product
+     * @details False if there are no joins and nothing was filtered before combining the tables
+     */
+    bool avoids_cross_product() const { return reduces_rows; }
+
+    /**
+     * @brief Combine the tables
+     * @details Can be called only once. The consumer receives the rows of the cross product satisfying the applied
+                conditions in batches of `ExecutionSettings::batch_rows` rows, with the columns in the FROM order.
+                Columns the statement doesn't refer to may be left out. It is called at least once, with an empty
+                table if there are no rows. The batches are put together and consumed in parallel on the shared
+                **WorkerPool**
+     */
+    void execute(const BatchConsumer& consumer);
+
+    /**
+     * @brief Stop passing batches to the consumer of `execute`
+     * @details Can be called by the consumer. The batches already being made are still passed on
+     */
+    void stop() { stopped = true; }
+
+    /**
+     * @brief Describe the operators combining the tables
+     * @details After `execute` the joins are named by the algorithms actually used and carry their measurements.
+                Before it they are named by the kind of the condition
+     */
+    PlanNode get_plan() const;
+
+    /**
+     * @brief Get the part of the condition that is not applied by `execute`
+     * @return The condition or an empty string if there is none
+     */
+    std::string get_residual_condition() const;
+
+    /**
+     * @brief Largest number of connected tables ordered by dynamic programming over all subsets
+     * @details Larger groups are ordered greedily
+     */
+    static constexpr size_t max_exhaustive_tables = 10;
+
+private:
+    /**
+     * @brief A column of one of the tables
+     */
+    struct ColumnReference{
+        size_t table;
+        size_t column;
+    };
+
+    /**
+     * @brief Equality of columns of two different tables
+     */
+    struct EquiJoin{
+        ColumnReference left;
+        ColumnReference right;
+    };
+
+    /**
+     * @brief `value BETWEEN lower AND upper` with both bounds in another table than the value
+     */
+    struct BandJoin{
+        ColumnReference value;
+        ColumnReference lower;
+        ColumnReference upper;
+    };
+
+    /**
+     * @brief Any other condition referring to columns of exactly two tables
+     */
+    struct ThetaJoin{};
+
+    /**
+     * @brief A condition connecting two tables
+     */
+    struct JoinCondition{
+        std::variant<EquiJoin, BandJoin, ThetaJoin> join;
+        std::pair<size_t, size_t> tables;
+        std::optional<double> selectivity;  /**< Estimated fraction of the pairs of rows satisfying it, if known */
+        std::vector<Token> condition;
+    };
+
+    /**
+     * @brief Join of two groups of tables
+     * @details The groups are identified by one of their tables. The joined group keeps the id of the left one.
+                Exactly one of the equalities, the band condition and the other conditions is set
+     */
+    struct Step{
+        size_t left;
+        size_t right;
+        std::vector<EquiJoin> keys;
+        std::optional<BandJoin> band;
+        std::vector<std::vector<Token>> predicates;     /**< Evaluated by a nested-loop join */
+        std::string description;                        /**< The conditions of the join */
+        std::vector<bool> members;                      /**< Whether each table is in the joined group */
+    };
+
+    /**
+     * @brief Joined tables as the indexes of their rows in the inputs
+     */
+    struct Group{
+        std::vector<size_t> members;    /**< Tables in the order of their row indexes */
+        std::vector<size_t> row_ids;    /**< Index of a row of each member for each row, stored consecutively */
+
+        size_t row_count() const { return row_ids.size() / members.size(); }
+    };
+
+    std::vector<std::pair<const Table&, std::string>> tables;
+    std::vector<TableHeader> headers;       /**< Headers of the inputs */
+
+    /**
+     * @brief The needed columns of the tables with the aliases applied and their own conditions applied
+     * @details Read by `execute` if the plan is just the cross product of the tables, never read
+                if only the plan is made
+     */
+    std::vector<Table> inputs;
+
+    std::vector<double> input_rows;         /**< Row count of each input, estimated if only the plan is made */
+
+    std::atomic<bool> stopped = false;      /**< Whether the rest of the batches are skipped */
+
+    bool reduces_rows = false;              /**< Whether there are joins or conditions of single tables */
+
+    std::vector<std::vector<size_t>> base_columns;  /**< Column of the table for each column of the input */
+    std::vector<bool> filtered;                     /**< Whether a condition removed rows of the input */
+    std::vector<size_t> versions;                   /**< Version of each table the input was copied from */
+
+    std::vector<std::string> filter_conditions;     /**< Conditions applied to each input, empty if none */
+    std::vector<OperatorStatistics> scan_statistics;
+    std::vector<OperatorStatistics> filter_statistics;
+
+    std::vector<std::string> step_algorithms;       /**< Algorithms used by the executed steps */
+    std::vector<OperatorStatistics> step_statistics;
+    OperatorStatistics cross_product_statistics;    /**< Combining the groups not connected by a join */
+    OperatorStatistics materialize_statistics;
+
+    const VariableList& variables;
+    SelectCallback& select_callback;
+    ExecutionSettings settings;
+    bool plan_only;                         /**< Whether the tables aren't read, only the plan is made */
+
+    std::vector<JoinCondition> join_conditions;
+    std::vector<bool> used;                 /**< Join conditions executed by the steps */
+
+    std::vector<Step> steps;                /**< In the execution order */
+
+    std::vector<Token> condition;
+    std::vector<std::vector<Token>> residual;
+
+    /**
+     * @brief Find the table and the column a name refers to
+     * @return The column or `std::nullopt` if the name isn't a column of exactly one table
+     */
+    std::optional<ColumnReference> resolve_column(const std::string& name) const;
+
+    /**
+     * @brief Find the tables a condition refers to
+     * @details Names that aren't columns of any table (variables, keywords, misspelled names) are skipped
+     * @return Sorted indexes of the tables or `std::nullopt` if a name can't be resolved to a single
+               table or the condition contains a subquery
+     */
+    std::optional<std::vector<size_t>> get_referenced_tables(const std::vector<Token>& conjunct) const;
+
+    /**
+     * @brief Try to recognize an equality of columns of two tables
+     */
+    std::optional<JoinCondition> get_equi_join(const std::vector<Token>& conjunct) const;
+
+    /**
+     * @brief Try to recognize a band condition
+     * @details The three columns must have the same type other than CHAR, so that sorting orders
+                the values as the comparison does
+     */
+    std::optional<JoinCondition> get_band_join(const std::vector<Token>& conjunct) const;
+
+    /**
+     * @brief Get the type of a column
+     */
+    Cell::DataType get_type(const ColumnReference& column) const;
+
+    /**
+     * @brief Get the statistics of a column of an input
+     */
+    ColumnStatistics get_column_statistics(const ColumnReference& column) const;
+
+    /**
+     * @brief Estimate the fraction of the pairs of rows with equal values in two columns
+     */
+    double estimate_equality_selectivity(const ColumnReference& left, const ColumnReference& right) const;
+
+    /**
+     * @brief Get the selectivity of a condition, estimating it if it isn't known
+     */
+    double get_selectivity(const JoinCondition& join_condition) const;
+
+    /**
+     * @brief Estimate the number of rows of a join of a set of tables
+     * @param members Whether each table is in the set
+     */
+    double estimate_rows(const std::vector<bool>& members) const;
+
+    /**
+     * @brief Order the joins of connected tables by dynamic programming over their subsets
+     * @details Minimizes the sum of the estimated sizes of the intermediate results
+     * @param group Group id of each table, updated by the added steps
+     */
+    void plan_exhaustive(const std::vector<size_t>& component, std::vector<size_t>& group);
+
+    /**
+     * @brief Order the joins of connected tables by always doing the join with the smallest result
+     * @param group Group id of each table, updated by the added steps
+     */
+    void plan_greedy(const std::vector<size_t>& component, std::vector<size_t>& group);
+
+    /**
+     * @brief Check if an unused condition connects two groups
+     */
+    bool connects(size_t left, size_t right, const std::vector<size_t>& group) const;
+
+    /**
+     * @brief Add a step joining two groups using the unused conditions between them
+     * @param group Group id of each table, updated by the step
+     */
+    void add_step(size_t left, size_t right, std::vector<size_t>& group);
+
+    /**
+     * @brief Create the batches of the result in parallel and pass them to the consumer
+     * @param row_count Number of rows of the result
+     * @param make_batch Creates the batch of `row_count` rows starting at `first_row` as `make_batch(first_row, row_count)`
+     */
+    void produce_batches(size_t row_count, const std::function<Table(size_t, size_t)>& make_batch,
+        const BatchConsumer& consumer);
+
+    /**
+     * @brief Copy the needed columns of a table and apply its own conditions
+     * @details The table is processed in morsels of `ExecutionSettings::batch_rows` rows in parallel.
+                All the morsels are copied under one lock of the table, the conditions are applied after it
+     */
+    Table read_input(size_t table);
+
+    /**
+     * @brief Call `callback(row, key)` with the join key of each row of a group
+     * @param columns Columns of the member tables forming the key
+     * @param types Types the values are compared in
+     */
+    void for_each_key(const Group& group, const std::vector<ColumnReference>& columns, const std::vector<Cell::DataType>& types,
+        const std::function<void(size_t, std::optional<TableRow>)>& callback) const;
+
+    /**
+     * @brief Get the join keys of the rows of a group
+     */
+    JoinKeys get_keys(const Group& group, const std::vector<ColumnReference>& columns,
+        const std::vector<Cell::DataType>& types) const;
+
+    /**
+     * @brief Match the rows of two groups on equal columns
+     * @details An index is used if possible. If the hash table would exceed the memory budget, the keys are partitioned into temporary
+                files and joined by a grace hash join. Otherwise merge join is used if both inputs are
+                already sorted by the key and hash join if they aren't
+     */
+    JoinPairs join_on_keys(const Group& left, const Group& right, const std::vector<ColumnReference>& left_columns,
+        const std::vector<ColumnReference>& right_columns, const std::vector<Cell::DataType>& types,
+        std::string& algorithm) const;
+
+    /**
+     * @brief Check if the rows of a group can be looked up in an index of a table instead of scanning it
+     * @details The group must be a single table without filtered rows, so that its rows are
+                the rows of the table, and the other group must be much smaller
+     */
+    bool can_use_index(const Group& inner, const Group& outer) const;
+
+    /**
+     * @brief Match the rows of two groups on equal columns by looking up the keys of one group
+              in a hash index of the other one
+     * @return The pairs or `std::nullopt` if neither group can use an index or the table changed since it was read
+     */
+    std::optional<JoinPairs> index_join(const Group& left, const Group& right, const std::vector<ColumnReference>& left_columns,
+        const std::vector<ColumnReference>& right_columns, const std::vector<Cell::DataType>& types) const;
+
+    /**
+     * @brief Match the values with the ranges by looking up each range in an ordered index of the values
+     * @return Pairs (value row, bounds row) or `std::nullopt` if the values can't use an index
+                or their table changed since it was read
+     */
+    std::optional<JoinPairs> index_band_join(const Group& values, const Group& bounds, const BandJoin& band) const;
+
+    /**
+     * @brief Match the rows of two groups satisfying the conditions
+     * @details The pairs are evaluated in tiles of a bounded size, so that the memory used stays
+                proportional to the result. The tiles of the left group are processed in parallel
+     */
+    JoinPairs nested_loop_join(const Group& left, const Group& right,
+        const std::vector<std::vector<Token>>& predicates) const;
+
+    /**
+     * @brief Create the group of the matching pairs of rows of two groups
+     */
+    static Group combine_groups(const Group& left, const Group& right, const JoinPairs& pairs);
+
+    /**
+     * @brief Put together the rows of a group
+     * @return Table with the columns of the members in their order in the group
+     */
+    Table materialize(const Group& group) const;
+};
+
+#endif
@@ -0,0 +1,108 @@
+#ifndef JOIN_ALGORITHMS_H
+#define JOIN_ALGORITHMS_H
+
+#include "db/table.h"
+
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Join key of each row of one input
+ * @details The keys are already converted to the types they are compared in.
+            Rows with NULL in the key have `std::nullopt` and match nothing
+ */
+using JoinKeys = std::vector<std::optional<TableRow>>;
+
+/**
+ * @brief Matching rows of two inputs as pairs (left row index, right row index)
+ */
+using JoinPairs = std::vector<std::pair<size_t, size_t>>;
+
+/**
+ * @brief Match equal keys using a hash table built over the smaller input
+ */
+JoinPairs hash_join_pairs(const JoinKeys& left, const JoinKeys& right);
+
+/**
+ * @brief Match equal keys by sorting both inputs and merging them
+ * @details Needs less memory than `hash_join_pairs` and skips the sorting of keys that are already ordered
+ */
+JoinPairs merge_join_pairs(const JoinKeys& left, const JoinKeys& right);
+
+/**
+ * @brief Match values with the ranges containing them
+ * @details The values are sorted and the range of each bound is found by a binary search
+ * @param values Keys with a single cell
+ * @param bounds Keys with the lower and the upper bound, both inclusive
+ * @return Pairs (value index, bounds index)
+ */
+JoinPairs band_join_pairs(const JoinKeys& values, const JoinKeys& bounds);
+
+/**
+ * @brief Get a new path for a temporary file of an operator exceeding the memory budget
+ * @param directory Where the file is to be created, the system temporary directory if empty
+ */
+std::filesystem::path get_spill_path(std::filesystem::path directory);
+
+/**
+ * @brief Join keys of one input split by their hash into temporary files
+ * @details Equal keys always end up in partitions with the same number. Rows with NULL in the key are dropped.
+            The files are removed with the object
+ */
+class KeyPartitions{
+public:
+    /**
+     * @param partition_count Number of the files
+     * @param types Types of the key cells
+     * @param directory Where the files are created, the system temporary directory if empty
+     * @throws std::runtime_error if a file can't be created
+     */
+    KeyPartitions(size_t partition_count, std::vector<Cell::DataType> types, std::filesystem::path directory);
+
+    ~KeyPartitions();
+
+    KeyPartitions(const KeyPartitions&) = delete;
+
+    KeyPartitions& operator=(const KeyPartitions&) = delete;
+
+    /**
+     * @brief Write the key of a row to its partition
+     */
+    void add(size_t row, const std::optional<TableRow>& key);
+
+    /**
+     * @brief Read a partition back
+     * @details Writing is finished by the first read
+     * @return Pairs (key, row index)
+     */
+    std::vector<std::pair<TableRow, size_t>> read(size_t partition);
+
+    /**
+     * @brief Get the number of the files
+     */
+    size_t partition_count() const { return paths.size(); }
+
+private:
+    std::vector<Cell::DataType> types;
+    std::vector<std::filesystem::path> paths;
+    std::vector<std::ofstream> files;
+};
+
+/**
+ * @brief Match equal keys partition by partition
+ * @details Only a partition of each input is in memory at a time, so the hash tables
+            stay small even if the whole inputs wouldn't fit (grace hash join)
+ * @param left Keys of the left input, with the same number of partitions as `right`
+ */
+JoinPairs grace_hash_join_pairs(KeyPartitions& left, KeyPartitions& right);
+
+/**
+ * @brief Check if the keys are in ascending order
+ * @details Missing keys are ignored
+ */
+bool keys_sorted(const JoinKeys& keys);
+
+#endif
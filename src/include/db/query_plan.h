@@ -0,0 +1,107 @@
+#ifndef QUERY_PLAN_H
+#define QUERY_PLAN_H
+
+#include "db/table.h"
+
+#include <atomic>
+#include <chrono>
+#include <optional>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Measurements of an executed operator
+ */
+struct OperatorStatistics{
+    std::optional<size_t> rows;     /**< Number of rows produced, `std::nullopt` if not executed */
+    double milliseconds = 0;        /**< Time spent in the operator by all threads, including its subqueries but not its inputs */
+    size_t memory = 0;              /**< Estimated peak number of bytes of the operator's result and structures */
+
+    /**
+     * @brief Add the time since `start`
+     */
+    void add_time(std::chrono::steady_clock::time_point start);
+
+    /**
+     * @brief Record the produced table
+     */
+    void set_output(const Table& table);
+
+    /**
+     * @brief Record a produced batch of rows
+     * @details The rows are summed over the batches, the memory is the largest batch
+     */
+    void add_batch(const Table& batch);
+
+    /**
+     * @brief Add the measurements of another part of the work of the operator
+     * @details The rows and the times are summed, the memory is the larger one
+     */
+    void add(const OperatorStatistics& other);
+};
+
+/**
+ * @brief Operator of the plan of a SELECT statement
+ */
+struct PlanNode{
+    std::string name;                   /**< Kind of the operator, e.g. `Scan` or `HashJoin` */
+    std::string details;                /**< Tables, columns or conditions the operator works with */
+    std::vector<PlanNode> children;     /**< Inputs of the operator */
+    OperatorStatistics statistics;
+};
+
+/**
+ * @brief Measurements of the subqueries evaluated by an operator
+ */
+struct SubqueryStatistics{
+    size_t executions = 0;
+    OperatorStatistics statistics;  /**< The rows are summed over the executions, the memory is the largest result */
+};
+
+/**
+ * @brief Wraps a select callback to measure the subqueries evaluated through it
+ * @details The callback may be called from several threads at once
+ */
+class SubqueryProfiler{
+public:
+    explicit SubqueryProfiler(SelectCallback& inner);
+
+    SubqueryProfiler(const SubqueryProfiler&) = delete;
+
+    SubqueryProfiler& operator=(const SubqueryProfiler&) = delete;
+
+    /**
+     * @brief Get the callback to use instead of the wrapped one
+     */
+    SelectCallback& get_callback() { return callback; }
+
+    /**
+     * @brief Add the measurements since the last call to `target` and start new ones
+     */
+    void take(SubqueryStatistics& target);
+
+private:
+    SelectCallback& inner;
+    SelectCallback callback;
+
+    std::atomic<size_t> executions = 0;
+    std::atomic<size_t> rows = 0;
+    std::atomic<size_t> nanoseconds = 0;
+    std::atomic<size_t> memory = 0;
+};
+
+/**
+ * @brief Estimate the number of bytes taken by the rows of a table
+ * @details The contents of strings are not counted
+ */
+size_t estimate_table_bytes(const Table& table);
+
+/**
+ * @brief Convert a plan to a table with a row for each operator
+ * @details The operators are listed in preorder, each with the id of its parent (NULL for the root).
+            The measured columns are NULL for operators that weren't executed
+ * @param analyzed Whether to include the measurements, the measured columns are all NULL if not
+ */
+Table plan_to_table(const PlanNode& root, bool analyzed);
+
+#endif
@@ -0,0 +1,122 @@
+#ifndef SORT_H
+#define SORT_H
+
+#include "db/execution_settings.h"
+#include "db/table.h"
+
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <vector>
+
+/**
+ * @brief A column the rows are sorted by
+ */
+struct SortKey{
+    size_t column;
+    bool descending = false;
+    bool nulls_first = false;
+};
+
+/**
+ * @brief Sorts the rows of a stream of batches, keeping the order of the rows with equal keys
+ * @details The rows are collected in memory and sorted at once if they fit into the memory budget.
+            Otherwise the collected rows are sorted and written to a temporary file as a sorted run
+            whenever they exceed the budget, and `finish` merges the runs (external merge sort).
+            At most `merge_fan_in` runs are merged at once, more runs are first merged into longer runs.
+ */
+class ExternalSort{
+public:
+    /**
+     * @param header Header of the sorted rows
+     * @param keys Columns to sort by, the first one is the most significant
+     * @param settings Limits of the execution
+     */
+    ExternalSort(TableHeader header, std::vector<SortKey> keys, const ExecutionSettings& settings);
+
+    /**
+     * @brief Add a batch of rows with the header given to the constructor
+     * @throws std::runtime_error if a temporary file can't be written
+     */
+    void add(Table batch);
+
+    /**
+     * @brief Get all the added rows sorted
+     * @throws std::runtime_error if a temporary file can't be read
+     */
+    Table finish();
+
+    /**
+     * @brief Check if the rows were written to temporary files
+     */
+    bool spilled() const { return run_count > 0; }
+
+    /**
+     * @brief Largest number of runs merged at once
+     */
+    static constexpr size_t merge_fan_in = 16;
+
+private:
+    /**
+     * @brief Temporary file with sorted rows
+     * @details The type of each cell is stored with it. The file is removed with the object
+     */
+    class Run{
+    public:
+        explicit Run(const std::filesystem::path& directory);
+
+        ~Run();
+
+        Run(const Run&) = delete;
+
+        Run& operator=(const Run&) = delete;
+
+        void write(const TableRow& row);
+
+        /**
+         * @brief Read the next row, the first read finishes the writing
+         * @return The row or `std::nullopt` at the end of the file
+         */
+        std::optional<TableRow> read();
+
+    private:
+        std::filesystem::path path;
+        std::ofstream output;
+        std::ifstream input;
+    };
+
+    TableHeader header;
+    std::vector<SortKey> keys;
+    ExecutionSettings settings;
+
+    std::vector<TableRow> rows;                 /**< Rows not written to a run yet */
+    size_t memory = 0;                          /**< Estimated size of `rows` */
+
+    std::vector<std::unique_ptr<Run>> runs;     /**< In the order of their rows */
+    size_t run_count = 0;                       /**< Number of the runs written, including the merged ones */
+
+    /**
+     * @brief Check if a row goes before another one
+     */
+    bool precedes(const TableRow& left, const TableRow& right) const;
+
+    /**
+     * @brief Sort the rows in memory and write them to a new run
+     */
+    void spill();
+
+    /**
+     * @brief Merge the runs, earlier runs go first among the rows with equal keys
+     * @param output Receives the rows in the sorted order
+     */
+    void merge(std::vector<std::unique_ptr<Run>> inputs, const std::function<void(TableRow&&)>& output) const;
+
+    /**
+     * @brief Estimate the memory a row takes
+     */
+    static size_t estimate_row_bytes(const TableRow& row);
+};
+
+#endif
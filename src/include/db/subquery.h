@@ -0,0 +1,155 @@
+#ifndef SUBQUERY_H
+#define SUBQUERY_H
+
+#include "db/table.h"
+#include "db/variable_list.h"
+#include "db/subquery_cache.h"
+#include "parse/select_clauses.h"
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+class SubqueryCaches;
+
+/**
+ * @brief Results of a subquery for the rows of the outer table
+ * @details Rows known to have the same result share a single table
+ */
+struct SubqueryResults{
+    std::vector<std::shared_ptr<const Table>> tables;   /**< Result for each row */
+    bool shared = false;                                /**< All rows share the first result */
+};
+
+/**
+ * @brief A subquery of a condition evaluated against the rows of the outer table
+ * @details The straightforward way is to run the subquery once for every outer row.
+            EXISTS and IN subqueries correlated only by equalities between an outer
+            and an inner column can instead be executed once without the correlation
+            and matched to the outer rows through a hash table (a semi-join).
+            Their negations become anti-joins by negating the result.
+ */
+class Subquery{
+public:
+    /**
+     * @param statement The SELECT statement without the enclosing brackets
+     * @param table The outer table
+     * @param variables Variable bindings of the enclosing query
+     * @param select_callback Callback for evaluating the statement
+     * @param caches If not null, results shared with the evaluations of the same subquery on other outer tables
+     */
+    Subquery(std::string statement, const Table& table, const VariableList& variables,
+        SelectCallback& select_callback, SubqueryCaches* caches = nullptr);
+
+    /**
+     * @brief Run the subquery for each row of the outer table
+     * @details Results are memoized by the values of the outer columns they read.
+                An uncorrelated subquery reads none, so it runs only once
+                (once for all the outer tables sharing the caches)
+     * @param mode Part of the results that is needed
+     * @return The resulting table for each row
+     */
+    SubqueryResults evaluate(SelectMode mode = SelectMode::Full) const;
+
+    /**
+     * @brief Run the subquery for each row of the outer table using the given cache
+     */
+    SubqueryResults evaluate(SubqueryCache& cache, SelectMode mode = SelectMode::Full) const;
+
+    /**
+     * @brief Evaluate EXISTS as a semi-join
+     * @return Result for each row or `std::nullopt` if the subquery can't be decorrelated
+     */
+    std::optional<BoolVector> evaluate_exists() const;
+
+    /**
+     * @brief Evaluate IN as a semi-join
+     * @param values The searched value for each row
+     * @return Result for each row or `std::nullopt` if the subquery can't be decorrelated
+     */
+    std::optional<BoolVector> evaluate_in(const CellVector& values) const;
+
+private:
+    friend class SubqueryCaches;
+
+    /**
+     * @brief Equality between a column of the outer table and a column of the subquery
+     */
+    struct Correlation{
+        ColumnDescriptor outer_column;
+        std::string inner_column;
+    };
+
+    /**
+     * @brief The subquery with the correlation removed
+     */
+    struct Decorrelated{
+        std::vector<Correlation> correlations;
+        Table result;   /**< Result of the subquery followed by the inner correlation columns */
+    };
+
+    std::string statement;
+    const Table& table;
+    const VariableList& variables;
+    SelectCallback& select_callback;
+    SubqueryCaches* caches;
+
+    /**
+     * @brief Run the subquery for a single row
+     * @param log If set, the reads of the row are recorded into it
+     */
+    Table evaluate_row(const TableRow& row, SelectMode mode, ReadLog* log = nullptr) const;
+
+    /**
+     * @brief Try to recognize a correlation condition
+     * @param inner_tables Tables of the subquery
+     */
+    std::optional<Correlation> get_correlation(const std::vector<Token>& condition,
+        const std::vector<TableReference>& inner_tables) const;
+
+    /**
+     * @brief Check if a column name refers to the outer table and nothing else
+     * @param inner_tables Tables of the subquery
+     */
+    bool is_outer_column(const std::string& name, const std::vector<TableReference>& inner_tables) const;
+
+    /**
+     * @brief Check if a column name can be resolved in the outer table, even ambiguously
+     */
+    bool resolves_in_outer(const std::string& name) const;
+
+    /**
+     * @brief Run the subquery once with the correlation conditions removed
+     * @param keep_projection If true, the projection is kept before the correlation columns
+     * @return The result or `std::nullopt` if the subquery depends on the outer row in another way
+     */
+    std::optional<Decorrelated> decorrelate(bool keep_projection) const;
+
+    /**
+     * @brief Get the decorrelated subquery, from the caches if they have it
+     * @return The decorrelated subquery or `nullptr` if it can't be decorrelated
+     */
+    std::shared_ptr<const Decorrelated> get_decorrelated(bool keep_projection) const;
+};
+
+/**
+ * @brief Results of the subqueries of a condition shared between its evaluations on several outer tables
+ * @details A condition evaluated on the parts of a larger table, all with the same header, would otherwise
+            run each uncorrelated subquery and each decorrelated semi-join again for every part.
+            The results are kept by the text of the subquery. Safe to use from several threads.
+ */
+class SubqueryCaches{
+private:
+    friend class Subquery;
+
+    std::mutex mutex;
+    std::map<std::pair<std::string, SelectMode>, SubqueryCache> results;    /**< By the statement and the mode */
+    std::map<std::pair<std::string, bool>, std::shared_ptr<const Subquery::Decorrelated>> decorrelated;  /**< By the statement and whether the projection is kept */
+};
+
+#endif
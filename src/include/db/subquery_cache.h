@@ -0,0 +1,77 @@
+#ifndef SUBQUERY_CACHE_H
+#define SUBQUERY_CACHE_H
+
+#include "db/table.h"
+#include "helper/row_container.h"
+
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief Cache of subquery results keyed by the outer row values they depend on
+ * @details A result is stored together with the outer columns read while computing it.
+            Another outer row with the same values in these columns would make the
+            subquery read the same values in the same order, so it has the same result.
+            Results that read different sets of columns are kept in separate maps.
+            Safe to use from several threads.
+ */
+class SubqueryCache{
+public:
+    /**
+     * @param max_cells Limit on the total number of cells of the cached tables
+     */
+    explicit SubqueryCache(size_t max_cells = default_max_cells);
+
+    /**
+     * @brief Find the result for an outer row
+     * @return The result or `nullptr` if it isn't cached
+     */
+    std::shared_ptr<const Table> find(const TableRow& row);
+
+    /**
+     * @brief Store the result for an outer row
+     * @param read_columns Indexes of the outer columns read while computing the result
+     * @details Nothing is stored if the result doesn't fit into the limit
+     */
+    void insert(const TableRow& row, const std::vector<size_t>& read_columns, std::shared_ptr<const Table> result);
+
+    /**
+     * @brief Get the number of successful lookups
+     */
+    size_t hits() const;
+
+    /**
+     * @brief Get the number of failed lookups
+     */
+    size_t misses() const;
+
+    static constexpr size_t default_max_cells = 1 << 20;
+
+private:
+    /**
+     * @brief Results that depend on the same outer columns
+     */
+    struct Entry{
+        std::vector<size_t> columns;
+        std::unordered_map<TableRow, std::shared_ptr<const Table>, TableRowHash, TableRowIdentical> results;
+    };
+
+    mutable std::mutex mutex;
+    
+    std::vector<Entry> entries;
+
+    size_t max_cells;
+    size_t cached_cells = 0;
+
+    size_t hit_count = 0;
+    size_t miss_count = 0;
+
+    /**
+     * @brief Select the values of given columns from a row
+     */
+    static TableRow make_key(const TableRow& row, const std::vector<size_t>& columns);
+};
+
+#endif
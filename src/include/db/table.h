@@ -6,6 +6,9 @@
 #include <shared_mutex>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <tuple>
 #include <valarray>
 #include <functional>
 
@@ -17,6 +20,24 @@ using BoolVector = std::valarray<bool>;
 using TableRow = std::vector<Cell>;
 
 class Table;
+class TableIndex;
+class SubqueryCaches;
+
+/**
+ * @brief Kind of an index of the rows of a table
+ */
+enum class IndexKind{
+    Hash,       /**< Equality lookups */
+    Ordered     /**< Equality and range lookups */
+};
+
+/**
+ * @brief Statistics of the values of a column
+ */
+struct ColumnStatistics{
+    size_t distinct_values;
+    double non_null_fraction;
+};
 
 /**
  * @brief Describes a column in a database table
@@ -72,6 +93,12 @@ public:
      */
     TableHeader add_alias(const std::string& alias) const;
     
+    /**
+     * @brief Create a new header with some of the columns
+     * @param indexes Indexes of the kept columns in the new order
+     */
+    TableHeader select(const std::vector<size_t>& indexes) const;
+    
     /**
      * @brief Join two headers together
      * @return New header containing columns from both inputs
@@ -97,6 +124,19 @@ private:
 
 class VariableList;
 
+/**
+ * @brief Part of the result of a SELECT statement that is needed
+ */
+enum class SelectMode{
+    Full,       /**< The projected result */
+    FirstRow    /**< Only whether there is a row, the result is not projected and may be cut short */
+};
+
+/**
+ * @brief Callback for evaluating SELECT subqueries
+ */
+using SelectCallback = std::function<Table(TokenStream&, const VariableList&, SelectMode)>;
+
 /**
  * @brief Represents a database table
  */
@@ -112,6 +152,12 @@ public:
      */
     Table(std::vector<std::pair<Cell::DataType, std::string>> columns);
     
+    /**
+     * @brief Constructor with header and rows
+     * @details The rows must have the columns of the header
+     */
+    Table(TableHeader header, std::vector<TableRow> rows);
+    
     Table(Table&& other) noexcept;
     Table& operator=(Table&& other) noexcept;
     
@@ -121,9 +167,10 @@ public:
      * @param variables Variable bindings for the evaluation
      * @param select_callback Callback for evaluating subqueries
      * @param negate Whether to negate the condition and filter out rows that satisfy the condition
+     * @param subquery_caches If not null, results of the subqueries shared with other evaluations of the condition
      */
     void filter_by_condition(TokenStream& stream, const VariableList& variables,
-        std::function<Table(TokenStream&, const VariableList&)> select_callback, bool negate = false);
+        SelectCallback select_callback, bool negate = false, SubqueryCaches* subquery_caches = nullptr);
     
     /**
      * @brief Evaluate an aggregate condition
@@ -133,7 +180,7 @@ public:
      * @return True if the condition is satisfied, false otherwise
      */
     bool evaluate_aggregate_condition(TokenStream& stream, const VariableList& variables,
-        std::function<Table(TokenStream&, const VariableList&)> select_callback) const;
+        SelectCallback select_callback) const;
     
     /**
      * @brief Project the table through a set of expression
@@ -145,9 +192,10 @@ public:
     Table project(const std::vector<std::string>& expressions, const VariableList& variables, bool aggregate_mode = false) const;
     
     /**
-     * @brief Remove duplicate rows from the table
+     * @brief Keep only some of the rows
+     * @param keep Whether to keep each row
      */
-    void deduplicate();
+    void keep_rows(const BoolVector& keep);
 
     /**
      * @brief Add a row to the table with name-value pairs
@@ -163,22 +211,92 @@ public:
     void add_row(const std::vector<std::string>& data);
     
     /**
-     * @brief Group the table by specified columns
-     * @param group_columns Column names to group by
-     * @detail The rows are moved from the current table and it is left empty
+     * @brief Create a cross product of multiple tables
      */
-    std::vector<Table> group_by(const std::vector<std::string>& group_columns);
+    static Table cross_product(std::vector<std::pair<const Table&, std::string>> tables);
     
     /**
-     * @brief Create a cross product of multiple tables
+     * @brief Create a part of the cross product of multiple tables
+     * @details Rows are numbered in the order of the full cross product
+     * @param first_row Number of the first row of the part
+     * @param row_count Maximal number of rows of the part
      */
-    static Table cross_product(std::vector<std::pair<const Table&, std::string>> tables);
+    static Table cross_product(const std::vector<std::pair<const Table&, std::string>>& tables,
+        size_t first_row, size_t row_count);
+    
+    /**
+     * @brief Get the number of rows of the cross product of multiple tables
+     */
+    static size_t cross_product_size(const std::vector<std::pair<const Table&, std::string>>& tables);
+    
+    /**
+     * @brief Combine rows of several tables into one table
+     * @details Used to materialize the result of a join from the indexes of the matching rows
+     * @param row_ids Index of a row of each table for each row of the result, stored consecutively
+     * @return Table with the columns of all the tables in the given order
+     */
+    static Table combine_rows(const std::vector<const Table*>& tables, const std::vector<size_t>& row_ids);
+    
+    /**
+     * @brief Create a table from some of the columns
+     * @param header Header of the new table
+     * @param columns Index of the column of this table for each column of the new one
+     */
+    Table select_columns(TableHeader header, const std::vector<size_t>& columns) const;
+    
+    /**
+     * @brief Create a table from some of the columns of a range of rows
+     * @param first_row Index of the first row, may be past the end
+     * @param row_count Maximal number of rows
+     */
+    Table select_columns(TableHeader header, const std::vector<size_t>& columns, size_t first_row, size_t row_count) const;
+    
+    /**
+     * @brief Get an index of the rows by some of the columns
+     * @details Built on the first request and kept until the rows of the table change.
+                The returned index stays valid even then, but doesn't describe the new rows
+     * @param types Types the values of the columns are compared in
+     */
+    std::shared_ptr<const TableIndex> get_index(IndexKind kind, const std::vector<size_t>& columns,
+        const std::vector<Cell::DataType>& types) const;
+    
+    /**
+     * @brief Get the statistics of the values of a column
+     * @details Counted on the first request and kept with the indexes until the rows of the table change
+     */
+    ColumnStatistics get_column_statistics(size_t column) const;
+    
+    /**
+     * @brief Get the statistics of the values of a column as they were at a version of the table
+     * @param version Version returned by `get_version`
+     * @return The statistics or `std::nullopt` if the rows changed since the version
+     */
+    std::optional<ColumnStatistics> get_column_statistics(size_t column, size_t version) const;
+    
+    /**
+     * @brief Get the number of changes of the rows
+     * @details Read while holding the lock from `lock_rows`, it is the version of the rows being read
+     */
+    size_t get_version() const;
+    
+    /**
+     * @brief Get an index of the rows as they were at a version of the table
+     * @param version Version returned by `get_version`
+     * @return The index or nullptr if the rows changed since the version
+     */
+    std::shared_ptr<const TableIndex> get_index(IndexKind kind, const std::vector<size_t>& columns,
+        const std::vector<Cell::DataType>& types, size_t version) const;
     
     /**
      * @brief Vertically join another table to this one
      */
     void vertical_join(const Table& other);
     
+    /**
+     * @brief Vertically join another table to this one, moving its rows
+     */
+    void vertical_join(Table&& other);
+    
     /**
      * @brief Copy the table
      */
@@ -189,6 +307,11 @@ public:
      */
     void clear_rows();
     
+    /**
+     * @brief Check if the table has no rows
+     */
+    bool empty() const;
+    
     /*
      * @brief A type for limiting method access to only some clases
      */
@@ -198,6 +321,9 @@ public:
         
         friend class ConditionEvaluation;
         friend class ExpressionEvaluation;
+        friend class JoinPlanner;
+        friend class Subquery;
+        friend class SubqueryCache;
         friend class Table;
         friend void serialize_table(const Table& table, std::ostream& os);
     };
@@ -211,9 +337,24 @@ public:
     
     /**
      * @brief Evaluate a condition on the table
+     * @param subquery_caches If not null, results of the subqueries shared with other evaluations of the condition
      */
     BoolVector evaluate_condition(TokenStream& stream, const VariableList& variables,
-        std::function<Table(TokenStream&, const VariableList&)> select_callback, Accessor accessor = Accessor()) const;
+        SelectCallback select_callback, SubqueryCaches* subquery_caches = nullptr, Accessor accessor = Accessor()) const;
+    
+    /**
+     * @brief Lock the rows of the table against changes
+     * @details While the lock is held, the methods taking an accessor read the same rows
+     */
+    std::shared_lock<std::shared_mutex> lock_rows(Accessor accessor = Accessor()) const;
+    
+    /**
+     * @brief Create a table from some of the columns of a range of rows, with the rows locked by the caller
+     * @param first_row Index of the first row, may be past the end
+     * @param row_count Maximal number of rows
+     */
+    Table select_locked_columns(TableHeader header, const std::vector<size_t>& columns, size_t first_row,
+        size_t row_count, Accessor accessor = Accessor()) const;
     
     const std::vector<TableRow>& get_rows([[maybe_unused]] Accessor accessor = Accessor()) const {return rows;};
     const TableHeader& get_header([[maybe_unused]] Accessor accessor = Accessor()) const {return header;};
@@ -232,6 +373,28 @@ private:
     
     mutable std::shared_mutex mutex;
     
+    using IndexKey = std::tuple<IndexKind, std::vector<size_t>, std::vector<Cell::DataType>>;
+    
+    mutable std::mutex index_mutex;
+    mutable std::map<IndexKey, std::shared_ptr<const TableIndex>> indexes;
+    mutable std::map<size_t, ColumnStatistics> column_statistics;
+    size_t version = 0;     /**< Number of changes of the rows, guarded by `index_mutex` */
+    
+    /**
+     * @brief Get a cached index or build it, with the rows and `index_mutex` locked by the caller
+     */
+    std::shared_ptr<const TableIndex> find_index(IndexKind kind, const std::vector<size_t>& columns,
+        const std::vector<Cell::DataType>& types) const;
+    
+    /**
+     * @brief Get cached statistics of a column or count them, with the rows and `index_mutex` locked by the caller
+     */
+    ColumnStatistics find_column_statistics(size_t column) const;
+    
+    /**
+     * @brief Forget the indexes and the statistics after the rows change
+     */
+    void drop_indexes();
 };
 
 #endif
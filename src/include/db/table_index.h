@@ -0,0 +1,47 @@
+#ifndef TABLE_INDEX_H
+#define TABLE_INDEX_H
+
+#include "db/table.h"
+#include "helper/row_container.h"
+
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Index of the rows of a table by the values of some of its columns
+ * @details The values are converted to the types they are compared in.
+            Rows with NULL in the indexed columns match nothing, so they aren't indexed
+ */
+class TableIndex{
+public:
+    /**
+     * @param kind Hash index for equality lookups, ordered index for ranges too
+     * @param rows Rows of the table
+     * @param columns Indexed columns
+     * @param types Types the values of the columns are converted to
+     */
+    TableIndex(IndexKind kind, const std::vector<TableRow>& rows, const std::vector<size_t>& columns,
+        const std::vector<Cell::DataType>& types);
+
+    /**
+     * @brief Append the indexes of the rows with the given key
+     */
+    void find_equal(const TableRow& key, std::vector<size_t>& result) const;
+
+    /**
+     * @brief Append the indexes of the rows with a key in the range, in the key order
+     * @details Only for ordered indexes of a single column
+     * @param lower Inclusive lower bound
+     * @param upper Inclusive upper bound
+     */
+    void find_range(const Cell& lower, const Cell& upper, std::vector<size_t>& result) const;
+
+private:
+    IndexKind kind;
+
+    std::unordered_map<TableRow, std::vector<size_t>, TableRowHash, TableRowIdentical> buckets;    /**< Hash index */
+    std::vector<std::pair<TableRow, size_t>> entries;   /**< Ordered index, pairs (key, row index) */
+};
+
+#endif
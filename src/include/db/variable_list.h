@@ -3,12 +3,48 @@
 
 #include "db/table.h"
 
+#include <atomic>
+
+/**
+ * @brief Records which columns of a row were read
+ * @details Used to find out which values of an outer row a subquery depends on.
+            Safe to record into from several threads.
+ */
+class ReadLog {
+public:
+    /**
+     * @param column_count Number of columns of the observed row
+     */
+    explicit ReadLog(size_t column_count);
+    
+    /**
+     * @brief Mark a column as read
+     */
+    void record(size_t index);
+    
+    /**
+     * @brief Check if no column was read
+     */
+    bool empty() const;
+    
+    /**
+     * @brief Get indexes of the read columns in increasing order
+     */
+    std::vector<size_t> get_read_columns() const;
+    
+private:
+    std::vector<std::atomic<bool>> read;
+};
+
 /**
  * @brief A row combined with the header for variable access
  */
 class BoundRow {
 public:
-    BoundRow(const TableHeader& header, const TableRow& row);
+    /**
+     * @param log If set, reads of the values are recorded into it
+     */
+    BoundRow(const TableHeader& header, const TableRow& row, ReadLog* log = nullptr);
     
     /**
      * @brief Get a value by column name
@@ -17,9 +53,15 @@ public:
      */
     std::optional<std::pair<const Cell*, Cell::DataType>> get_value(const std::string& name) const;
     
+    /**
+     * @brief Record that a value returned by `get_value` was read
+     */
+    void record_read(const Cell* value) const;
+    
 private:
     const TableHeader& header;
     const TableRow& row;
+    ReadLog* log;
 };
 
 /**
@@ -41,6 +83,12 @@ public:
      */
     Cell::DataType get_type(const std::string& name) const;
     
+    /**
+     * @brief Check if a variable name can be resolved
+     * @throws InvalidQuery if the name is ambiguous within a single row
+     */
+    bool contains(const std::string& name) const;
+    
     /**
      * @brief Add a row to VariableList
      */
@@ -51,8 +99,9 @@ private:
     
     /**
      * @brief Look up a variable
+     * @return The row containing the variable, its value and type
      */
-    std::pair<const Cell*, Cell::DataType> get_info(const std::string& name) const;
+    std::tuple<const BoundRow*, const Cell*, Cell::DataType> get_info(const std::string& name) const;
 };
 
 #endif
\ No newline at end of file
@@ -1,7 +1,63 @@
 #ifndef LIKE_H
 #define LIKE_H
 
+#include <memory>
 #include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @brief A LIKE pattern compiled for repeated matching
+ * @details `_` matches any character, `%` any string
+ */
+class LikePattern{
+public:
+    /**
+     * @brief Compile a pattern
+     */
+    explicit LikePattern(const std::string& pattern);
+
+    /**
+     * @brief Check if a string matches the pattern
+     */
+    bool matches(std::string_view value) const;
+
+    /**
+     * @brief Get a compiled pattern from the process-wide cache
+     * @details The pattern is compiled on the first request
+     */
+    static std::shared_ptr<const LikePattern> get(const std::string& pattern);
+
+private:
+    /**
+     * @brief Shape of the pattern, selects the matching strategy
+     */
+    enum class Kind{
+        Exact,      /**< `abc` */
+        Prefix,     /**< `abc%` */
+        Suffix,     /**< `%abc` */
+        Contains,   /**< `%abc%` */
+        General     /**< anything else */
+    };
+
+    Kind kind;
+
+    /**
+     * @brief Parts of the pattern separated by `%`
+     * @details The fast paths only use the single literal part
+     */
+    std::vector<std::string> segments;
+
+    bool anchored_start;    /**< Pattern doesn't start with `%` */
+    bool anchored_end;      /**< Pattern doesn't end with `%` */
+
+    /**
+     * @brief General matcher for patterns with `_` or several `%`
+     * @details Segments are matched greedily from the left, which is enough
+                because `%` can absorb anything between them
+     */
+    bool matches_general(std::string_view value) const;
+};
 
 /**
  * @brief Check if a string matches a LIKE pattern
@@ -9,4 +65,4 @@
  */
 bool is_like(const std::string& value, const std::string& pattern);
 
-#endif
\ No newline at end of file
+#endif
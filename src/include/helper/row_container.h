@@ -3,6 +3,8 @@
 
 #include "db/table.h"
 
+#include <optional>
+
 /**
  * @brief Combine two hash values into one
  */
@@ -41,4 +43,27 @@ struct TableRowIdentical{
     }
 };
 
+/**
+ * @brief Build a lookup key from some columns of a row
+ * @param types Types the cells are converted to, so that the keys compare as the columns would
+ * @return The key or `std::nullopt` if it contains NULL, which equals nothing
+ */
+inline std::optional<TableRow> make_typed_key(const TableRow& row, const std::vector<size_t>& columns,
+        const std::vector<Cell::DataType>& types){
+    TableRow key;
+    key.reserve(columns.size());
+
+    for(size_t i = 0; i < columns.size(); ++i){
+        Cell cell = row[columns[i]].convert(types[i]);
+
+        if(cell.type() == Cell::DataType::Null){
+            return std::nullopt;
+        }
+
+        key.push_back(std::move(cell));
+    }
+
+    return key;
+}
+
 #endif
\ No newline at end of file
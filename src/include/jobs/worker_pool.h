@@ -0,0 +1,70 @@
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <condition_variable>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief A fixed set of threads executing parallel loops
+ * @details The thread calling `parallel_for` works on the loop too, so a loop
+            started from inside another loop can't deadlock and a pool without
+            threads simply runs the loop on the caller
+ */
+class WorkerPool {
+public:
+    /**
+     * @param thread_count Number of threads besides the callers
+     */
+    explicit WorkerPool(size_t thread_count);
+
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    /**
+     * @brief Call `body(begin, end)` on consecutive ranges covering [0, count)
+     * @details Ranges of `chunk_size` indexes are handed out to the threads as they become free.
+                Returns after all ranges are processed
+     * @throws The exception thrown by the range with the lowest index, the remaining ranges are skipped
+     */
+    void parallel_for(size_t count, size_t chunk_size, const std::function<void(size_t, size_t)>& body);
+
+    /**
+     * @brief Get the number of threads besides the callers
+     */
+    size_t thread_count() const { return threads.size(); }
+
+    /**
+     * @brief Get the process-wide pool with a thread for each additional core
+     */
+    static WorkerPool& get_shared();
+
+private:
+    struct Loop;
+
+    std::mutex mutex;
+    std::condition_variable work_available;
+    std::list<std::shared_ptr<Loop>> loops;     /**< Loops that may have unclaimed ranges */
+    bool stopping = false;
+
+    std::vector<std::thread> threads;
+
+    /**
+     * @brief Main function of the threads
+     */
+    void work();
+
+    /**
+     * @brief Remove a loop with no unclaimed ranges from the queue
+     */
+    void remove_loop(const std::shared_ptr<Loop>& loop);
+};
+
+#endif
@@ -0,0 +1,80 @@
+#ifndef SELECT_CLAUSES_H
+#define SELECT_CLAUSES_H
+
+#include "parse/token_stream.h"
+
+#include <optional>
+#include <set>
+#include <string>
+#include <vector>
+
+/**
+ * @brief A table in the FROM clause of a SELECT statement
+ */
+struct TableReference{
+    std::string name;
+    std::string alias;  /**< Equals the name if no alias is given */
+};
+
+/**
+ * @brief A key of the ORDER BY clause of a SELECT statement
+ */
+struct OrderKey{
+    std::string expression;
+    bool descending = false;
+    bool nulls_first = false;   /**< By default `NULL`s go last in ascending order and first in descending order */
+};
+
+/**
+ * @brief Clauses of a SELECT statement split apart without evaluating them
+ * @details Used to analyze and rewrite statements before they are executed
+ */
+struct SelectClauses{
+    bool distinct = false;
+    std::vector<std::string> projection;    /**< Projection expressions */
+    std::vector<TableReference> tables;
+    std::vector<Token> where;               /**< WHERE condition, empty if not present */
+    std::vector<std::string> group_by;      /**< GROUP BY columns, empty if not present */
+    std::vector<Token> having;              /**< HAVING condition, empty if not present */
+    std::vector<OrderKey> order_by;         /**< ORDER BY keys, empty if not present */
+};
+
+/**
+ * @brief Read the clauses of a SELECT statement
+ * @details The terminating `;` is not consumed
+ * @throws InvalidQuery if the statement is malformed
+ */
+SelectClauses read_select_clauses(TokenStream& stream);
+
+/**
+ * @brief Split a condition into parts joined by a top-level AND
+ * @details The AND of BETWEEN is not a separator.
+            A condition containing a top-level OR is returned as a single part
+ */
+std::vector<std::vector<Token>> split_conjuncts(const std::vector<Token>& condition);
+
+/**
+ * @brief Convert tokens back to a string that tokenizes the same way
+ */
+std::string tokens_to_string(const std::vector<Token>& tokens);
+
+/**
+ * @brief Try to read a column reference (`name` or `alias.name`) spanning all the tokens
+ * @return The column name or an empty string if the tokens are something else
+ */
+std::string tokens_to_column_name(const std::vector<Token>& tokens);
+
+/**
+ * @brief Check if any of the expressions may contain an aggregate function
+ */
+bool has_aggregate(const std::vector<std::string>& expressions);
+
+/**
+ * @brief Get all the names the clauses of a SELECT statement may use to refer to columns
+ * @details Includes the names used in subqueries. Both `alias.name` and `name` are included for
+            qualified names, so a column not referred to by either of them is not needed for the evaluation
+ * @return The names or `std::nullopt` if all columns are needed
+ */
+std::optional<std::set<std::string>> get_referenced_names(const SelectClauses& clauses);
+
+#endif
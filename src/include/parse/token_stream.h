@@ -59,6 +59,12 @@ private:
     std::string value;
 };
 
+/**
+ * @brief Check if a token is the given keyword or special character, case insensitively
+ * @details A string literal with the same text doesn't match
+ */
+bool is_word(const Token& token, const std::string& word);
+
 /**
  * @brief Stream of tokens for parsing
  */
@@ -99,7 +105,7 @@ public:
     
     /**
      * @brief Skip the next token if it matches the expected string
-     * @details Case insensitive
+     * @details Case insensitive, string literals don't match
      * @throws InvalidQuery if the token doesn't match
      */
     void ignore_token(const std::string& token);
@@ -112,7 +118,7 @@ public:
     
     /**
      * @brief Try to skip the next token if it matches
-     * @details Case insensitive
+     * @details Case insensitive, string literals don't match
      * @return True if the token was matched and ignored, false otherwise
      */
     bool try_ignore_token(const std::string& token);
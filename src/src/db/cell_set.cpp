@@ -0,0 +1,119 @@
+#include "db/cell_set.h"
+
+#include <algorithm>
+
+CellSet::CellSet(std::vector<Cell> values){
+    for(auto&& value : values){
+        // NULL never equals anything
+        if(value.type() != Cell::DataType::Null){
+            this->values.push_back(std::move(value));
+        }
+    }
+    
+    if(!try_build_typed<int>()){
+        try_build_typed<std::string>();
+    }
+}
+
+template<class T>
+bool CellSet::try_build_typed(){
+    std::unordered_set<T> set;
+    
+    for(const auto& value : values){
+        const T* typed = value.get_if<T>();
+        
+        if(typed == nullptr){
+            return false;
+        }
+        
+        set.insert(*typed);
+    }
+    
+    typed_values = std::move(set);
+    return true;
+}
+
+bool CellSet::contains_generic(const Cell& value) const {
+    return std::ranges::find(values, value) != values.end();
+}
+
+template<class T>
+bool CellSet::contains_typed(const std::unordered_set<T>& set, const Cell& value) const {
+    if(const T* typed = value.get_if<T>()){
+        return set.contains(*typed);
+    }
+    // values of other types may still be equal after promotion
+    return contains_generic(value);
+}
+
+bool CellSet::contains_typed(const std::monostate&, const Cell& value) const {
+    return contains_generic(value);
+}
+
+bool CellSet::contains(const Cell& value) const {
+    return std::visit([&](const auto& set){
+        return contains_typed(set, value);
+    }, typed_values);
+}
+
+BoolVector CellSet::contains(const CellVector& values) const {
+    BoolVector result(values.size());
+    
+    // the representation is picked once for the whole column
+    std::visit([&](const auto& set){
+        for(size_t i = 0; i < values.size(); ++i){
+            result[i] = contains_typed(set, values[i]);
+        }
+    }, typed_values);
+    
+    return result;
+}
+
+template<class T>
+std::optional<bool> DistinctValues::insert_typed(std::unordered_set<T>& set, const Cell& value){
+    if(const T* typed = value.get_if<T>()){
+        return set.insert(*typed).second;
+    }
+    return std::nullopt;
+}
+
+std::optional<bool> DistinctValues::insert_typed(std::monostate&, const Cell&){
+    return std::nullopt;
+}
+
+std::optional<bool> DistinctValues::insert_typed(std::unordered_set<Cell, std::hash<Cell>, CellIdentical>& set, const Cell& value){
+    return set.insert(value).second;
+}
+
+bool DistinctValues::insert(const Cell& value){
+    if(values.empty()){
+        // the index is typed by the first value
+        if(value.get_if<int>() != nullptr){
+            index = std::unordered_set<int>();
+        }
+        else if(value.get_if<float>() != nullptr){
+            index = std::unordered_set<float>();
+        }
+        else if(value.get_if<std::string>() != nullptr){
+            index = std::unordered_set<std::string>();
+        }
+        else {
+            index = std::unordered_set<Cell, std::hash<Cell>, CellIdentical>();
+        }
+    }
+
+    auto inserted = std::visit([&](auto& set){ return insert_typed(set, value); }, index);
+
+    if(!inserted.has_value()){
+        // a value of another type, the values so far are moved to a hash set of cells
+        std::unordered_set<Cell, std::hash<Cell>, CellIdentical> cells(values.begin(), values.end());
+        inserted = cells.insert(value).second;
+        index = std::move(cells);
+    }
+
+    if(inserted.value()){
+        values.push_back(value);
+    }
+
+    return inserted.value();
+}
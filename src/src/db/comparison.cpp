@@ -0,0 +1,327 @@
+#include "db/comparison.h"
+#include "db/exceptions.h"
+
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+using enum Cell::DataType;
+
+ComparisonOperator token_to_comparison_operator(const Token& token){
+    static const std::map<std::string, ComparisonOperator> operators = {
+        {"<", ComparisonOperator::Less},
+        {"=", ComparisonOperator::Equal},
+        {">", ComparisonOperator::Greater},
+        {"<=", ComparisonOperator::LessEqual},
+        {">=", ComparisonOperator::GreaterEqual},
+        {"<>", ComparisonOperator::NotEqual}
+    };
+
+    if(!operators.contains(token.get_value())){
+        throw InvalidQuery("Invalid operator " + token.get_value());
+    }
+
+    return operators.at(token.get_value());
+}
+
+/**
+ * @brief Call `f` with the functor corresponding to the operator
+ */
+template<class F>
+static decltype(auto) with_operator(ComparisonOperator op, F&& f){
+    switch(op){
+        case ComparisonOperator::Less:
+            return f(std::less<>());
+        case ComparisonOperator::Equal:
+            return f(std::equal_to<>());
+        case ComparisonOperator::Greater:
+            return f(std::greater<>());
+        case ComparisonOperator::LessEqual:
+            return f(std::less_equal<>());
+        case ComparisonOperator::GreaterEqual:
+            return f(std::greater_equal<>());
+        case ComparisonOperator::NotEqual:
+            return f(std::not_equal_to<>());
+    }
+    std::unreachable();
+}
+
+/**
+ * @brief Comparison of cells holding values of known types
+ * @details Mirrors the promotion rules of Cell, cells of other types (NULL) never match
+ */
+template<class OP, class L, class R>
+struct TypedComparison{
+    bool operator()(const Cell& left, const Cell& right) const {
+        const L* left_value = left.get_if<L>();
+        const R* right_value = right.get_if<R>();
+
+        if(left_value == nullptr || right_value == nullptr){
+            return false;
+        }
+
+        if constexpr(std::is_same_v<L, char> && std::is_same_v<R, char>){
+            // chars are promoted to strings, which compare as unsigned
+            return OP()(static_cast<unsigned char>(*left_value), static_cast<unsigned char>(*right_value));
+        } else if constexpr(std::is_arithmetic_v<L> && std::is_arithmetic_v<R>){
+            using Common = std::common_type_t<L, R>;
+            return OP()(static_cast<Common>(*left_value), static_cast<Common>(*right_value));
+        } else {
+            return OP()(*left_value, *right_value);
+        }
+    }
+};
+
+/**
+ * @brief Comparison of cells of arbitrary types
+ */
+template<class OP>
+struct GenericComparison{
+    bool operator()(const Cell& left, const Cell& right) const {
+        return OP()(left, right);
+    }
+};
+
+/**
+ * @brief Comparison of a NULL column with anything
+ */
+struct NullComparison{
+    bool operator()(const Cell&, const Cell&) const {
+        return false;
+    }
+};
+
+/**
+ * @brief Get the type shared by all non-NULL cells
+ * @return The type, `Null` if all cells are NULL or `std::nullopt` if the types differ
+ */
+template<class C>
+static std::optional<Cell::DataType> get_column_type(const C& column){
+    Cell::DataType result = Null;
+
+    for(const Cell& cell : column){
+        Cell::DataType type = cell.type();
+
+        if(type == Null){
+            continue;
+        }
+        if(result == Null){
+            result = type;
+        }
+        else if(result != type){
+            return std::nullopt;
+        }
+    }
+
+    return result;
+}
+
+/**
+ * @brief Call `f` with the comparison functor specialized for the column types
+ */
+template<class OP, class F>
+static decltype(auto) with_comparison(std::optional<Cell::DataType> left, std::optional<Cell::DataType> right, F&& f){
+    if(left == Null || right == Null){
+        return f(NullComparison());
+    }
+    if(left == Int && right == Int){
+        return f(TypedComparison<OP, int, int>());
+    }
+    if(left == Int && right == Float){
+        return f(TypedComparison<OP, int, float>());
+    }
+    if(left == Float && right == Int){
+        return f(TypedComparison<OP, float, int>());
+    }
+    if(left == Float && right == Float){
+        return f(TypedComparison<OP, float, float>());
+    }
+    if(left == String && right == String){
+        return f(TypedComparison<OP, std::string, std::string>());
+    }
+    if(left == Char && right == Char){
+        return f(TypedComparison<OP, char, char>());
+    }
+    return f(GenericComparison<OP>());
+}
+
+bool compare_cells(ComparisonOperator op, const Cell& left, const Cell& right){
+    return with_operator(op, [&]<class OP>(OP){
+        return GenericComparison<OP>()(left, right);
+    });
+}
+
+void compare_columns(ComparisonOperator op, const CellVector& left, const CellVector& right,
+        BoolVector& selection, bool intersect){
+    if(selection.size() != left.size()){
+        selection.resize(left.size(), true);
+    }
+
+    auto left_type = get_column_type(left);
+    auto right_type = get_column_type(right);
+
+    with_operator(op, [&]<class OP>(OP){
+        with_comparison<OP>(left_type, right_type, [&](auto comparison){
+            for(size_t i = 0; i < left.size(); ++i){
+                if(intersect && !selection[i]){
+                    continue;
+                }
+                selection[i] = comparison(left[i], right[i]);
+            }
+        });
+    });
+}
+
+BoolVector compare_columns(ComparisonOperator op, const CellVector& left, const CellVector& right){
+    BoolVector result(left.size());
+
+    compare_columns(op, left, right, result);
+
+    return result;
+}
+
+BoolVector between_columns(const CellVector& value, const CellVector& lower, const CellVector& upper){
+    BoolVector result(value.size());
+
+    compare_columns(ComparisonOperator::LessEqual, lower, value, result);
+    compare_columns(ComparisonOperator::LessEqual, value, upper, result, true);
+
+    return result;
+}
+
+/**
+ * @brief Reduce the list of an ordering ANY/ALL comparison to the single value deciding it
+ * @details `x > ANY (...)` holds iff `x > MIN(...)` and `x > ALL (...)` iff `x > MAX(...)`
+            and there is no NULL, the other orderings are analogous.
+            This is only valid if promoting the values for the comparison keeps their order
+ * @return The value, NULL if the comparison can't hold, or `std::nullopt` if the reduction isn't valid
+ */
+static std::optional<Cell> reduce_quantified(ComparisonOperator op, std::optional<Cell::DataType> value_type,
+        const std::vector<Cell>& list, bool any){
+    bool greater = op == ComparisonOperator::Greater || op == ComparisonOperator::GreaterEqual;
+    bool less = op == ComparisonOperator::Less || op == ComparisonOperator::LessEqual;
+
+    if(!greater && !less){
+        return std::nullopt;
+    }
+
+    auto list_type = get_column_type(list);
+
+    if(!value_type.has_value() || !list_type.has_value()){
+        return std::nullopt;
+    }
+
+    auto is_numeric = [](Cell::DataType type){
+        return type == Int || type == Float;
+    };
+
+    bool same_order = value_type == list_type || value_type == Null || list_type == Null
+        || (is_numeric(*value_type) && is_numeric(*list_type));
+
+    if(!same_order){
+        // e.g. numbers compared as strings are ordered differently
+        return std::nullopt;
+    }
+
+    // > ANY and < ALL need the minimum, < ANY and > ALL the maximum
+    bool want_minimum = greater == any;
+
+    std::optional<Cell> result;
+    bool has_null = false;
+
+    with_comparison<std::less<>>(list_type, list_type, [&](auto less_than){
+        for(const Cell& cell : list){
+            if(cell.type() == Null){
+                has_null = true;
+                continue;
+            }
+            if(!result.has_value()
+                || (want_minimum ? less_than(cell, *result) : less_than(*result, cell))){
+                result = cell;
+            }
+        }
+    });
+
+    if(!result.has_value() || (!any && has_null)){
+        // empty, only NULLs or ALL with a NULL
+        return Cell();
+    }
+
+    return result;
+}
+
+BoolVector compare_quantified(ComparisonOperator op, const CellVector& values,
+        const std::vector<std::vector<Cell>>& lists, bool any){
+    BoolVector result(values.size());
+
+    with_operator(op, [&]<class OP>(OP){
+        for(size_t i = 0; i < values.size(); ++i){
+            const Cell& value = values[i];
+            const std::vector<Cell>& list = lists[i];
+
+            if(list.empty()){
+                // ALL holds for an empty subquery, ANY doesn't
+                result[i] = !any;
+                continue;
+            }
+
+            if(auto bound = reduce_quantified(op, value.type(), list, any)){
+                result[i] = GenericComparison<OP>()(value, bound.value());
+                continue;
+            }
+
+            with_comparison<OP>(value.type(), get_column_type(list), [&](auto comparison){
+                auto matches = [&](const Cell& other){
+                    return comparison(value, other);
+                };
+
+                result[i] = any ? std::ranges::any_of(list, matches) : std::ranges::all_of(list, matches);
+            });
+        }
+    });
+
+    return result;
+}
+
+BoolVector compare_quantified(ComparisonOperator op, const CellVector& values,
+        const std::vector<Cell>& list, bool any){
+    BoolVector result(values.size());
+
+    if(list.empty()){
+        // ALL holds for an empty subquery, ANY doesn't
+        result = !any;
+        return result;
+    }
+
+    auto values_type = get_column_type(values);
+
+    if(auto bound = reduce_quantified(op, values_type, list, any)){
+        // a single comparison with the bound for each row
+        with_operator(op, [&]<class OP>(OP){
+            with_comparison<OP>(values_type, bound->type(), [&](auto comparison){
+                for(size_t i = 0; i < values.size(); ++i){
+                    result[i] = comparison(values[i], bound.value());
+                }
+            });
+        });
+
+        return result;
+    }
+
+    with_operator(op, [&]<class OP>(OP){
+        with_comparison<OP>(values_type, get_column_type(list), [&](auto comparison){
+            for(size_t i = 0; i < values.size(); ++i){
+                auto matches = [&](const Cell& other){
+                    return comparison(values[i], other);
+                };
+
+                result[i] = any ? std::ranges::any_of(list, matches) : std::ranges::all_of(list, matches);
+            }
+        });
+    });
+
+    return result;
+}
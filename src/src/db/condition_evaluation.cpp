@@ -1,9 +1,13 @@
 #include "db/condition_evaluation.h"
+#include "db/cell_set.h"
+#include "db/subquery.h"
 #include "helper/like.h"
 #include "helper/read_array.h"
 #include "parse/token_to_cell.h"
 #include "db/exceptions.h"
 
+#include <unordered_map>
+
 template<class Pred, class F, class ... C>
 static BoolVector apply_condition(const Pred& condition, const F& first, const C&... others){
     BoolVector result(first.size());
@@ -18,15 +22,20 @@ static BoolVector apply_condition(const Pred& condition, const F& first, const C
 BoolVector ConditionEvaluation::evaluate_exists(){
     stream.ignore_token("(");
     
-    auto select_result = process_select();
-    
-    BoolVector result = apply_condition([](const Table& table){
-        return table.get_rows().size() > 0;
-    }, select_result);
+    Subquery subquery = read_subquery();
     
     stream.ignore_token(")");
     
-    return result;
+    if(auto semi_join = subquery.evaluate_exists()){
+        return std::move(semi_join.value());
+    }
+    
+    // a single row is enough to decide
+    auto select_result = subquery.evaluate(SelectMode::FirstRow);
+    
+    return apply_condition([](const std::shared_ptr<const Table>& table){
+        return !table->empty();
+    }, select_result.tables);
 }
 
 BoolVector ConditionEvaluation::evaluate_inner_condition(){
@@ -58,46 +67,47 @@ BoolVector ConditionEvaluation::evaluate_is(CellVector expression){
 }
 
 BoolVector ConditionEvaluation::evaluate_like(CellVector expression){
-    auto pattern = stream.get_token(TokenType::String);
+    auto pattern = LikePattern::get(stream.get_token(TokenType::String));
     
-    return apply_condition([pattern](const Cell& cell){
+    return apply_condition([&pattern](const Cell& cell){
+        if(const std::string* string = cell.get_if<std::string>()){
+            return pattern->matches(*string);
+        }
+        
         auto string = cell.repr();
         if(!string.has_value()){
             // NULL is not like anything
             return false;
         }
-        return is_like(string.value(), pattern);
+        return pattern->matches(string.value());
     }, expression);
 }
 
 BoolVector ConditionEvaluation::evaluate_in(CellVector expression){
     stream.ignore_token("(");
     
-    std::vector<std::vector<Cell>> searched_values;
-    
-    if(stream.peek_token().like("SELECT")){
-        searched_values = process_select_vectors();
-    }
-    else{
-        auto tokens_in_array = read_array(stream);
-        
-        std::vector<Cell> cells_in_array;
+    if(is_word(stream.peek_token(), "SELECT")){
+        Subquery subquery = read_subquery();
         
-        for(auto& token : tokens_in_array){
-            cells_in_array.push_back(parse_token_to_cell(token));
-        }
+        stream.ignore_token(")");
         
-        // searched values are same for all rows
-        searched_values = std::vector(expression.size(), cells_in_array);
+        return evaluate_in_subquery(expression, subquery);
+    }
+    
+    auto tokens_in_array = read_array(stream);
+    
+    std::vector<Cell> cells_in_array;
+    
+    for(auto& token : tokens_in_array){
+        cells_in_array.push_back(parse_token_to_cell(token));
     }
     
     stream.ignore_token(")");
     
-    BoolVector result = apply_condition([](const Cell& target, const std::vector<Cell>& values){
-        return std::count(std::begin(values), std::end(values), target) > 0;
-    }, expression, searched_values);
+    // searched values are same for all rows
+    CellSet searched_values(std::move(cells_in_array));
     
-    return result;
+    return searched_values.contains(expression);
 }
 
 BoolVector ConditionEvaluation::evaluate_between(CellVector expression){
@@ -107,80 +117,57 @@ BoolVector ConditionEvaluation::evaluate_between(CellVector expression){
     
     auto [right_type, right_side_expressions] = table.evaluate_expression(stream, variables);
     
-    BoolVector result = (left_side_expressions <= expression) && (expression <= right_side_expressions);
-    
-    return result;
-}
-
-ConditionEvaluation::Comparator<Cell> ConditionEvaluation::operator_token_to_comparator(const Token& token){
-    static const std::map<std::string, Comparator<Cell>> operator_to_comparator = {
-        {"<", std::less<Cell>()},
-        {"=", std::equal_to<Cell>()},
-        {">", std::greater<Cell>()},
-        {"<=", std::less_equal<Cell>()},
-        {">=", std::greater_equal<Cell>()},
-        {"<>", std::not_equal_to<Cell>()}
-    };
-    
-    if(!operator_to_comparator.contains(token.get_value())){
-        throw InvalidQuery("Invalid operator " + token.get_value());
-    }
-    
-    return operator_to_comparator.at(token.get_value());
+    return between_columns(expression, left_side_expressions, right_side_expressions);
 }
 
-BoolVector ConditionEvaluation::evaluate_compare_subquery(CellVector expression, Comparator<Cell> comparator, bool has_any, bool has_all){
+BoolVector ConditionEvaluation::evaluate_compare_subquery(CellVector expression, ComparisonOperator op, bool has_any, bool has_all){
     stream.ignore_token("(");
     
     if(has_any && has_all){
         throw InvalidQuery("Cannot use ANY and ALL together");
     }
     
+    Subquery subquery = read_subquery();
+    
+    stream.ignore_token(")");
+    
+    if(has_any && op == ComparisonOperator::Equal){
+        // = ANY is the same as IN
+        return evaluate_in_subquery(expression, subquery);
+    }
+    
+    auto select_result = subquery.evaluate();
+    
     if(!has_all && !has_any){
-        auto query_result = process_select_singles();
-        stream.ignore_token(")");
+        auto query_result = process_select_singles(select_result);
         
-        return apply_condition(comparator, expression, query_result);
+        return compare_columns(op, expression, query_result);
     }
     
-    auto vectors = process_select_vectors();
+    if(select_result.shared){
+        return compare_quantified(op, expression, extract_vector(*select_result.tables.front()), has_any);
+    }
     
-    stream.ignore_token(")");
+    auto vectors = process_select_vectors(select_result);
     
-    return apply_condition([&comparator, has_any](const Cell& value, const std::vector<Cell>& possibilites){
-        auto evaluations = apply_condition([value, &comparator](const Cell& possibility){
-            return comparator(value, possibility);
-        }, possibilites);
-        
-        if(has_any){
-            // called with any
-            return evaluations.max() == true;
-        }
-        
-        else{
-            // called with all
-            return evaluations.min() == true;
-        }
-    }, expression, vectors);
+    return compare_quantified(op, expression, vectors, has_any);
 }
 
 BoolVector ConditionEvaluation::evaluate_compare(CellVector expression){
-    Token comparator_token = stream.get_token();
+    Token operator_token = stream.get_token();
     
-    auto comparator = operator_token_to_comparator(comparator_token);
+    auto op = token_to_comparison_operator(operator_token);
     
     bool has_any = stream.try_ignore_token("ANY");
     bool has_all = stream.try_ignore_token("ALL");
     
-    if(stream.peek_token().like("(")){
-        return evaluate_compare_subquery(std::move(expression), comparator, has_any, has_all);
+    if(is_word(stream.peek_token(), "(")){
+        return evaluate_compare_subquery(std::move(expression), op, has_any, has_all);
     }
     
     auto [right_type, right_expression] = table.evaluate_expression(stream, variables);
     
-    BoolVector result = apply_condition(comparator, expression, right_expression);
-    
-    return result;
+    return compare_columns(op, expression, right_expression);
 }
 
 BoolVector ConditionEvaluation::evaluate_condition_switch(CellVector expression){
@@ -269,10 +256,14 @@ static std::string get_inside_brackets(TokenStream& stream){
     while(true){
         auto next = stream.peek_token();
         
-        if(next.like("(")){
+        if(next.get_type() == TokenType::Empty){
+            throw InvalidQuery("Unmatched bracket");
+        }
+        
+        if(is_word(next, "(")){
             nesting_level++;
         }
-        if(next.like(")")){
+        if(is_word(next, ")")){
             nesting_level--;
         }
         
@@ -280,31 +271,44 @@ static std::string get_inside_brackets(TokenStream& stream){
             break;
         }
         
-        result += next.get_value() + " ";
+        result += next.get_raw() + " ";
         stream.get_token();
     }
     
     return result;
 }
 
-Table ConditionEvaluation::process_select_single_row(const std::string& statement, const BoundRow& extra_vars){
-    auto vars = variables + extra_vars;
-    
-    TokenStream new_stream(statement);
-    
-    return select_callback(new_stream, vars);
+Subquery ConditionEvaluation::read_subquery(){
+    return Subquery(get_inside_brackets(stream), table, variables, select_callback, subquery_caches);
 }
 
-std::vector<Table> ConditionEvaluation::process_select(){
-    std::string select_text = get_inside_brackets(stream);
-    select_text += ";";
+BoolVector ConditionEvaluation::evaluate_in_subquery(const CellVector& expression, const Subquery& subquery){
+    if(auto semi_join = subquery.evaluate_in(expression)){
+        return std::move(semi_join.value());
+    }
     
-    std::vector<Table> result;
+    auto select_result = subquery.evaluate();
     
-    for(auto&& row : table.get_rows()){
-        BoundRow bound(table.get_header(), row);
+    if(select_result.shared){
+        CellSet searched_values(extract_vector(*select_result.tables.front()));
         
-        result.push_back(process_select_single_row(select_text, bound));
+        return searched_values.contains(expression);
+    }
+    
+    // rows sharing a result also share the set built from it
+    std::unordered_map<const Table*, CellSet> searched_values;
+    
+    BoolVector result(expression.size());
+    
+    for(size_t i = 0; i < expression.size(); ++i){
+        const Table* select_table = select_result.tables[i].get();
+        
+        auto iterator = searched_values.find(select_table);
+        if(iterator == searched_values.end()){
+            iterator = searched_values.emplace(select_table, CellSet(extract_vector(*select_table))).first;
+        }
+        
+        result[i] = iterator->second.contains(expression[i]);
     }
     
     return result;
@@ -335,25 +339,29 @@ std::vector<Cell> ConditionEvaluation::extract_vector(const Table& table){
     return result;
 }
 
-CellVector ConditionEvaluation::process_select_singles(){
-    auto tables = process_select();
+CellVector ConditionEvaluation::process_select_singles(const SubqueryResults& select_result){
+    const auto& tables = select_result.tables;
+    
+    if(select_result.shared){
+        return CellVector(extract_single_cell(*tables.front()), tables.size());
+    }
     
     CellVector result(tables.size());
     
     for(size_t i = 0; i < tables.size(); ++i){
-        result[i] = extract_single_cell(tables[i]);
+        result[i] = extract_single_cell(*tables[i]);
     }
     
     return result;
 }
 
-std::vector<std::vector<Cell>> ConditionEvaluation::process_select_vectors(){
-    auto tables = process_select();
+std::vector<std::vector<Cell>> ConditionEvaluation::process_select_vectors(const SubqueryResults& select_result){
+    const auto& tables = select_result.tables;
     
     std::vector<std::vector<Cell>> result(tables.size());
     
     for(size_t i = 0; i < tables.size(); ++i){
-        result[i] = extract_vector(tables[i]);
+        result[i] = extract_vector(*tables[i]);
     }
     
     return result;
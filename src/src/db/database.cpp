@@ -2,11 +2,21 @@
 #include "db/exceptions.h"
 #include "parse/keywords.h"
 #include "parse/type.h"
+#include "parse/select_clauses.h"
 #include "helper/read_array.h"
 #include "db/variable_list.h"
 #include "db/table_serialization.h"
+#include "db/join.h"
+#include "db/distinct.h"
+#include "db/sort.h"
+#include "db/subquery.h"
 
+#include <algorithm>
+#include <chrono>
 #include <mutex>
+#include <numeric>
+#include <ranges>
+#include <optional>
 
 Database::Database(std::vector<std::pair<Table, std::string>> table_list){
     for(auto&& [table, name] : table_list){
@@ -91,6 +101,11 @@ std::string Database::process_query_pick_type(TokenStream& stream){
         return process_select(stream);
     }
 
+    if(command.like("EXPLAIN")){
+        auto lock = std::shared_lock(tables_lock);
+        return process_explain(stream);
+    }
+
     if(command.like("INSERT")){
         auto lock = std::shared_lock(tables_lock);
         return process_insert(stream);
@@ -218,160 +233,487 @@ std::string Database::process_insert(TokenStream& stream){
     return "Row inserted into table " + table_name;
 }
 
-static std::vector<std::string> read_projection_list(TokenStream& stream){
-    std::vector<std::string> projection_expressions(1);
+std::vector<std::pair<const Table&, std::string>> Database::get_selected_tables(const std::vector<TableReference>& references){
+    std::vector<std::pair<const Table&, std::string>> taken_tables;
+
+    for(const auto& reference : references){
+        taken_tables.emplace_back(get_table(reference.name), reference.alias);
+    }
+    
+    return taken_tables;
+}
+
+void Database::filter_by_where(Table& table, const std::string& condition, const VariableList& variables,
+        SelectCallback& callback, SubqueryCaches* subquery_caches){
+    if(condition.empty()){
+        return;
+    }
+    
+    TokenStream stream(condition);
+    
+    table.filter_by_condition(stream, variables, callback, false, subquery_caches);
+    
+    stream.assert_end();
+}
+
+Table Database::evaluate_select_group(const SelectClauses& clauses, const VariableList& variables, HashAggregate& aggregate,
+        SelectCallback& callback, SelectStatistics& statistics){
+    auto start = std::chrono::steady_clock::now();
+    Table groups = aggregate.get_groups();
+
+    if(clauses.group_by.empty()){
+        return groups;
+    }
+
+    statistics.group.add_time(start);
+    statistics.group.set_output(groups);
+
+    if(clauses.having.empty()){
+        return groups;
+    }
+    
+    start = std::chrono::steady_clock::now();
+    filter_by_where(groups, aggregate.rewrite(tokens_to_string(clauses.having)), variables, callback);
+
+    statistics.having.add_time(start);
+    statistics.having.rows = groups.get_rows().size();
+    
+    return groups;
+}
 
+Table Database::evaluate_select_first_row(const std::vector<std::pair<const Table&, std::string>>& taken_tables,
+        const std::string& condition, const VariableList& variables){
+    size_t total_rows = Table::cross_product_size(taken_tables);
+    
+    // chunks grow so that an early match is cheap and a late one doesn't re-parse the condition too often
+    size_t chunk_size = first_row_min_chunk;
+    size_t first_row = 0;
+    
+    // the subqueries of the condition run once for all the chunks, not again for each of them
+    SubqueryCaches subquery_caches;
+    
     while(true){
-        Token token = stream.get_token();
+        Table chunk = Table::cross_product(taken_tables, first_row, chunk_size);
+        
+        filter_by_where(chunk, condition, variables, select_callback, &subquery_caches);
+        
+        first_row += chunk_size;
         
-        if(token.get_type() == TokenType::Empty){
-            throw InvalidQuery("No FROM statement found");
+        if(!chunk.empty() || first_row >= total_rows){
+            return chunk;
         }
+        
+        chunk_size = std::min(chunk_size * 2, first_row_max_chunk);
+    }
+}
 
-        if(token.like("FROM")){
-            break;
-        }
-        if(token.like(",")){
-            projection_expressions.push_back("");
-            continue;
+Table Database::evaluate_select_first_batch(JoinPlanner& planner, const VariableList& variables){
+    std::string condition = planner.get_residual_condition();
+    
+    // the subqueries of the condition run once for all the batches
+    SubqueryCaches subquery_caches;
+    
+    std::optional<Table> result;
+    std::mutex result_mutex;
+    
+    planner.execute([&](size_t, Table batch){
+        filter_by_where(batch, condition, variables, select_callback, &subquery_caches);
+        
+        auto lock = std::lock_guard(result_mutex);
+        
+        if(!result.has_value() || (result->empty() && !batch.empty())){
+            result = std::move(batch);
         }
-
-        if(!projection_expressions.back().empty()){
-            projection_expressions.back() += " ";
+        
+        if(!result->empty()){
+            planner.stop();
         }
-        projection_expressions.back() += token.get_raw();
-    }
+    });
     
-    return projection_expressions;
+    return std::move(result.value());
 }
 
-std::vector<std::pair<const Table&, std::string>> Database::read_selected_tables(TokenStream& stream){
-    std::vector<std::pair<const Table&, std::string>> taken_tables;
+/**
+ * @brief Find the projection expression an ORDER BY key repeats
+ * @return Index of the projected column or `std::nullopt` if the key isn't projected
+ */
+static std::optional<size_t> find_projected(const SelectClauses& clauses, const OrderKey& key){
+    auto found = std::ranges::find(clauses.projection, key.expression);
 
-    while(true){
-        std::string table_name = stream.get_token(TokenType::Identifier);
+    if(found == clauses.projection.end() || *found == "*"){
+        return std::nullopt;
+    }
 
-        auto next_token = stream.peek_token();
+    return found - clauses.projection.begin();
+}
 
-        std::string alias;
+/**
+ * @brief Get the ORDER BY expressions that aren't projected, they are evaluated as extra columns
+ * @throws InvalidQuery if there are any in a SELECT DISTINCT statement
+ */
+static std::vector<std::string> get_extra_sort_columns(const SelectClauses& clauses){
+    std::vector<std::string> extra;
 
-        if(next_token.get_type() == TokenType::Identifier && !is_keyword(next_token.get_value())){
-            alias = stream.get_token().get_value();
+    for(const auto& key : clauses.order_by){
+        if(find_projected(clauses, key).has_value()){
+            continue;
         }
-        else{
-            alias = table_name;
+
+        if(clauses.distinct){
+            throw InvalidQuery("ORDER BY expression " + key.expression + " of SELECT DISTINCT must be selected");
         }
 
-        const Table& table = get_table(table_name);
+        extra.push_back(key.expression);
+    }
+
+    return extra;
+}
 
-        taken_tables.emplace_back(table, alias);
+/**
+ * @brief Get the sort keys of a projected table with the extra columns at its end
+ */
+static std::vector<SortKey> get_sort_keys(const SelectClauses& clauses, size_t column_count, size_t extra_count){
+    std::vector<SortKey> keys;
+    size_t extra_column = column_count - extra_count;
 
-        if(!stream.try_ignore_token(",")){
-            break;
-        }
+    for(const auto& key : clauses.order_by){
+        auto column = find_projected(clauses, key);
+
+        keys.push_back({column.has_value() ? column.value() : extra_column++, key.descending, key.nulls_first});
     }
-    
-    return taken_tables;
+
+    return keys;
 }
 
-std::vector<Table> Database::evaluate_select_group(TokenStream& stream, const VariableList& variables, Table& table){
-    if(!stream.try_ignore_token("GROUP")){
-        std::vector<Table> result;
-        result.push_back(table.clone());
-        return result;
+/**
+ * @brief Project a table and append the extra columns evaluated on the same rows
+ */
+static Table project_with_extra(const Table& table, const std::vector<std::string>& projection,
+        const std::vector<std::string>& extra, const VariableList& variables, bool aggregate_mode = false){
+    Table projected = table.project(projection, variables, aggregate_mode);
+
+    if(extra.empty()){
+        return projected;
     }
-    
-    stream.ignore_token("BY");
-    std::vector<std::string> grouping_columns;
 
-    while(true){
-        std::string column_name = stream.get_token(TokenType::Identifier);
-        grouping_columns.push_back(column_name);
+    Table extra_columns = table.project(extra, variables, aggregate_mode);
 
-        if(!stream.try_ignore_token(",")){
-            break;
-        }
+    std::vector<TableRow> rows = projected.get_rows();
+    const auto& extra_rows = extra_columns.get_rows();
+
+    for(size_t i = 0; i < rows.size(); ++i){
+        rows[i].insert(rows[i].end(), extra_rows[i].begin(), extra_rows[i].end());
     }
 
-    auto groups = table.group_by(grouping_columns);
+    return Table(TableHeader::join(projected.get_header(), extra_columns.get_header()), std::move(rows));
+}
+
+Table Database::evaluate_select(TokenStream& stream, const VariableList& variables = {}, SelectMode mode = SelectMode::Full,
+        PlanNode* plan = nullptr){
+    SelectClauses clauses = read_select_clauses(stream);
 
-    if(!stream.try_ignore_token("HAVING")){
-        return groups;
+    // the subqueries are measured only for the plan
+    std::optional<SubqueryProfiler> profiler;
+    if(plan != nullptr){
+        profiler.emplace(select_callback);
     }
+
+    SelectCallback& callback = profiler.has_value() ? profiler->get_callback() : select_callback;
+
+    auto take_subqueries = [&profiler](SubqueryStatistics& target){
+        if(profiler.has_value()){
+            profiler->take(target);
+        }
+    };
+    
+    bool is_aggregate = has_aggregate(clauses.projection) || !clauses.group_by.empty();
+    
+    auto taken_tables = get_selected_tables(clauses.tables);
     
-    std::string having_condition;
-    while(!stream.peek_token().like(";") && !stream.empty()){
-        having_condition += stream.get_token().get_value() + " ";
+    JoinPlanner planner(taken_tables, clauses.where, get_referenced_names(clauses), variables, callback, settings);
+    
+    // aggregates yield a row even for no input, so they need the full evaluation
+    if(mode == SelectMode::FirstRow && !is_aggregate){
+        if(!planner.avoids_cross_product()){
+            return evaluate_select_first_row(taken_tables, planner.get_residual_condition(), variables);
+        }
+
+        return evaluate_select_first_batch(planner, variables);
     }
 
-    std::vector<Table> filtered_groups;
-    for(auto&& group : groups){
-        TokenStream stream(having_condition);
+    SelectStatistics statistics;
+    std::string residual = planner.get_residual_condition();
 
-        if(group.evaluate_aggregate_condition(stream, variables, select_callback)){
-            filtered_groups.push_back(std::move(group));
-        }
+    // the joined rows are filtered and projected or pre-aggregated a batch at a time in parallel
+    std::map<size_t, Table> outputs;
+    std::mutex outputs_mutex;
+    size_t next_output = 0;
+
+    std::optional<Table> result;
+
+    std::optional<DistinctFilter> distinct;
+    if(clauses.distinct){
+        distinct.emplace(settings);
     }
-    
-    return filtered_groups;
-}
 
-static bool has_aggregate(std::vector<std::string> expressions){
-    auto contains = [](const std::string& str, const std::string& substr) {
-        return str.find(substr) != std::string::npos;
+    // ORDER BY keys that aren't projected are projected into extra columns, removed after the sort
+    std::vector<std::string> extra_sort_columns = get_extra_sort_columns(clauses);
+    std::optional<ExternalSort> sort;
+
+    auto add_sorted = [&](Table table){
+        if(!sort.has_value()){
+            size_t column_count = table.get_header().column_count();
+            sort.emplace(table.get_header(), get_sort_keys(clauses, column_count, extra_sort_columns.size()), settings);
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        sort->add(std::move(table));
+        statistics.sort.add_time(start);
     };
-    
-    const std::vector<std::string> aggregate_functions = {"COUNT", "SUM", "AVG", "MAX", "MIN"};
 
-    for(auto&& expr : expressions){
-        auto upper = to_upper(expr);
+    // without DISTINCT and aggregates the sort collects the batches instead of the result
+    bool sort_batches = !clauses.order_by.empty() && !is_aggregate && !distinct.has_value();
+
+    std::optional<HashAggregate> aggregate;
+    std::once_flag aggregate_created;
+
+    // the subqueries of the condition run once for all the batches, not once per batch
+    SubqueryCaches subquery_caches;
+
+    planner.execute([&](size_t index, Table batch){
+        OperatorStatistics where;
+        OperatorStatistics group;
+        OperatorStatistics project;
+
+        auto start = std::chrono::steady_clock::now();
+        filter_by_where(batch, residual, variables, callback, &subquery_caches);
+        where.add_time(start);
+        where.add_batch(batch);
+
+        if(is_aggregate){
+            std::call_once(aggregate_created, [&]{
+                std::vector<std::string> aggregated = clauses.projection;
+                if(!clauses.group_by.empty() && !clauses.having.empty()){
+                    aggregated.push_back(tokens_to_string(clauses.having));
+                }
+                aggregated.insert(aggregated.end(), extra_sort_columns.begin(), extra_sort_columns.end());
+
+                aggregate.emplace(batch.get_header(), clauses.group_by, aggregated, variables, settings);
+            });
+
+            start = std::chrono::steady_clock::now();
+            aggregate->add(index, batch);
+            group.add_time(start);
+        } else {
+            start = std::chrono::steady_clock::now();
+            batch = project_with_extra(batch, clauses.projection, extra_sort_columns, variables);
+            project.add_time(start);
+            project.add_batch(batch);
+        }
+
+        auto lock = std::lock_guard(outputs_mutex);
+        statistics.where.add(where);
+        statistics.group.add(group);
+        statistics.project.add(project);
+
+        if(is_aggregate){
+            return;
+        }
+
+        // the batches are appended in order as soon as all the earlier ones are done, DISTINCT passes on their new rows
+        outputs.emplace(index, std::move(batch));
+
+        for(auto next = outputs.find(next_output); next != outputs.end(); next = outputs.find(++next_output)){
+            Table output = std::move(next->second);
+            outputs.erase(next);
+
+            if(distinct.has_value()){
+                start = std::chrono::steady_clock::now();
+                output = distinct->add(std::move(output));
+                statistics.distinct.add_time(start);
+            }
+
+            if(sort_batches){
+                add_sorted(std::move(output));
+            } else if(result.has_value()){
+                result->vertical_join(std::move(output));
+            } else {
+                result = std::move(output);
+            }
+        }
+    });
+
+    take_subqueries(statistics.where_subqueries);
+
+    if(is_aggregate){
+        const TableHeader& header = aggregate->get_header();
+
+        Table groups = evaluate_select_group(clauses, variables, aggregate.value(), callback, statistics);
+        take_subqueries(statistics.having_subqueries);
+        
+        auto start = std::chrono::steady_clock::now();
+        result = project_with_extra(Table(header), clauses.projection, extra_sort_columns, variables);
         
-        for(const auto& aggregate_function : aggregate_functions){
-            if(contains(upper, aggregate_function)){
-                return true;
+        if(clauses.group_by.empty() && groups.empty()){
+            // aggregates of no rows
+            result->vertical_join(project_with_extra(Table(header), clauses.projection, extra_sort_columns, variables, true));
+        } else {
+            std::vector<std::string> projection;
+            for(const auto& expression : clauses.projection){
+                projection.push_back(aggregate->rewrite(expression));
             }
+
+            std::vector<std::string> extra;
+            for(const auto& expression : extra_sort_columns){
+                extra.push_back(aggregate->rewrite(expression));
+            }
+
+            result->vertical_join(project_with_extra(groups, projection, extra, variables));
+        }
+
+        statistics.project.add_time(start);
+        statistics.project.set_output(result.value());
+        take_subqueries(statistics.project_subqueries);
+
+        if(distinct.has_value()){
+            start = std::chrono::steady_clock::now();
+            result = distinct->add(std::move(result.value()));
+            statistics.distinct.add_time(start);
         }
     }
-    
+
+    if(distinct.has_value()){
+        auto start = std::chrono::steady_clock::now();
+        distinct->finish(result.value());
+        statistics.distinct.add_time(start);
+        statistics.distinct.set_output(result.value());
+    }
+
+    if(!clauses.order_by.empty()){
+        if(!sort_batches){
+            add_sorted(std::move(result.value()));
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        result = sort->finish();
+
+        if(!extra_sort_columns.empty()){
+            std::vector<size_t> columns(result->get_header().column_count() - extra_sort_columns.size());
+            std::iota(columns.begin(), columns.end(), 0);
+
+            result = result->select_columns(result->get_header().select(columns), columns);
+        }
+
+        statistics.sort.add_time(start);
+        statistics.sort.set_output(result.value());
+        statistics.external_sort = sort->spilled();
+    }
+
+    if(plan != nullptr){
+        *plan = describe_select(clauses, planner, residual, statistics);
+    }
+
+    return std::move(result.value());
+}
+
+/**
+ * @brief Check if an expression or a condition contains a subquery
+ */
+static bool contains_subquery(const std::string& text){
+    TokenStream stream(text);
+
+    while(!stream.empty()){
+        if(stream.get_token().like("SELECT")){
+            return true;
+        }
+    }
+
     return false;
 }
 
-Table Database::evaluate_select(TokenStream& stream, const VariableList& variables = {}){
-    stream.ignore_token("SELECT");
-    bool distinct = stream.try_ignore_token("DISTINCT");
-    stream.try_ignore_token("ALL");
+/**
+ * @brief Join strings by commas
+ */
+static std::string join_list(const std::vector<std::string>& items){
+    std::string result;
 
-    auto projection_expressions = read_projection_list(stream);
+    for(const auto& item : items){
+        if(!result.empty()){
+            result += ", ";
+        }
+        result += item;
+    }
 
-    auto taken_tables = read_selected_tables(stream);
+    return result;
+}
+
+PlanNode Database::describe_select(const SelectClauses& clauses, const JoinPlanner& planner, const std::string& residual,
+        const SelectStatistics& statistics){
+    PlanNode plan = planner.get_plan();
 
-    Table combined_table = Table::cross_product(taken_tables);
+    // each operator takes the plan built so far as its input
+    auto add_operator = [&plan](std::string name, std::string details, const OperatorStatistics& operator_statistics){
+        PlanNode node{std::move(name), std::move(details), {}, operator_statistics};
+        node.children.push_back(std::move(plan));
+        plan = std::move(node);
+    };
+
+    auto add_subquery = [&plan](const std::string& expression, const SubqueryStatistics& subqueries){
+        if(!contains_subquery(expression)){
+            return;
+        }
 
-    if(stream.try_ignore_token("WHERE")){
-        combined_table.filter_by_condition(stream, variables, select_callback);
+        std::string details;
+        if(subqueries.statistics.rows.has_value()){
+            details = "executed " + std::to_string(subqueries.executions) + " times";
+        }
+
+        plan.children.push_back(PlanNode{"Subquery", details, {}, subqueries.statistics});
+    };
+
+    if(!residual.empty()){
+        add_operator("Filter", residual, statistics.where);
+        add_subquery(residual, statistics.where_subqueries);
     }
-    
-    bool is_aggregate = has_aggregate(projection_expressions);
-    
-    if(stream.peek_token().like("GROUP")){
-        is_aggregate = true;
+
+    if(!clauses.group_by.empty()){
+        add_operator("Group", join_list(clauses.group_by), statistics.group);
+
+        if(!clauses.having.empty()){
+            std::string having = tokens_to_string(clauses.having);
+
+            add_operator("Having", having, statistics.having);
+            add_subquery(having, statistics.having_subqueries);
+        }
     }
 
-    std::vector<Table> groups = evaluate_select_group(stream, variables, combined_table);
-    
-    combined_table.clear_rows();
-    Table result = combined_table.project(projection_expressions, variables);
-    
-    for(auto&& group : groups) {
-        auto projected = group.project(projection_expressions, variables, is_aggregate);
-        result.vertical_join(projected);
+    bool is_aggregate = has_aggregate(clauses.projection) || !clauses.group_by.empty();
+    std::string projection = join_list(clauses.projection);
+
+    add_operator(is_aggregate ? "Aggregate" : "Project", projection, statistics.project);
+    add_subquery(projection, statistics.project_subqueries);
+
+    if(clauses.distinct){
+        add_operator("Distinct", "", statistics.distinct);
     }
 
-    if(distinct){
-        result.deduplicate();
+    if(!clauses.order_by.empty()){
+        std::vector<std::string> keys;
+
+        for(const auto& key : clauses.order_by){
+            std::string description = key.expression + (key.descending ? " DESC" : " ASC");
+
+            if(key.nulls_first != key.descending){
+                description += key.nulls_first ? " NULLS FIRST" : " NULLS LAST";
+            }
+
+            keys.push_back(std::move(description));
+        }
+
+        add_operator(statistics.external_sort ? "ExternalSort" : "Sort", join_list(keys), statistics.sort);
     }
 
-    return result;
+    return plan;
 }
 
 std::string Database::process_select(TokenStream& stream){
@@ -384,6 +726,36 @@ std::string Database::process_select(TokenStream& stream){
     return response.str();
 }
 
+std::string Database::process_explain(TokenStream& stream){
+    stream.ignore_token("EXPLAIN");
+
+    bool analyze = stream.try_ignore_token("ANALYZE");
+
+    PlanNode plan;
+
+    if(analyze){
+        evaluate_select(stream, {}, SelectMode::Full, &plan);
+    }
+    else{
+        SelectClauses clauses = read_select_clauses(stream);
+        auto taken_tables = get_selected_tables(clauses.tables);
+        VariableList variables;
+
+        // only the row counts of the tables are read
+        JoinPlanner planner(taken_tables, clauses.where, get_referenced_names(clauses), variables, select_callback, settings,
+            true);
+
+        plan = describe_select(clauses, planner, planner.get_residual_condition(), SelectStatistics());
+    }
+
+    stream.ignore_token(";");
+
+    std::ostringstream response;
+    serialize_table(plan_to_table(plan, analyze), response);
+
+    return response.str();
+}
+
 std::string Database::process_delete(TokenStream& stream){
     stream.ignore_token("DELETE");
     stream.ignore_token("FROM");
@@ -0,0 +1,210 @@
+#include "db/distinct.h"
+#include "db/join_algorithms.h"
+#include "csv/csv.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+/**
+ * @brief Mixed into the hash of a row when choosing its partition
+ * @details Keeps the partitions from being correlated with the buckets of their hash sets
+ */
+static constexpr size_t partition_salt = 0x9e3779b97f4a7c15;
+
+/**
+ * @brief Estimated memory taken by an entry of a hash set besides the row
+ */
+static constexpr size_t hash_entry_overhead = 32;
+
+DistinctFilter::SpillFile::SpillFile(const std::filesystem::path& directory) :
+        path(get_spill_path(directory)), file(path, std::ios::trunc){
+    if(!file){
+        throw std::runtime_error("Failed to create a temporary file " + path.string());
+    }
+}
+
+DistinctFilter::SpillFile::~SpillFile(){
+    file.close();
+
+    std::error_code error;
+    std::filesystem::remove(path, error);
+}
+
+void DistinctFilter::SpillFile::write(size_t position, const TableRow& row){
+    VoidableRow line = {std::to_string(position)};
+
+    for(const auto& cell : row){
+        line.push_back(std::to_string((int)cell.type()));
+        line.push_back(cell.repr());
+    }
+
+    write_csv(file, {line});
+}
+
+std::vector<std::pair<size_t, TableRow>> DistinctFilter::SpillFile::read(){
+    file.close();
+
+    if(!file){
+        throw std::runtime_error("Failed to write a temporary file");
+    }
+
+    std::ifstream input(path);
+
+    if(!input){
+        throw std::runtime_error("Failed to read a temporary file " + path.string());
+    }
+
+    std::vector<std::pair<size_t, TableRow>> result;
+
+    for(const auto& line : read_csv(input)){
+        TableRow row;
+        row.reserve(line.size() / 2);
+
+        for(size_t i = 1; i + 1 < line.size(); i += 2){
+            auto type = (Cell::DataType)std::stoi(line[i].value());
+            row.push_back(line[i + 1].has_value() ? Cell(line[i + 1].value(), type) : Cell());
+        }
+
+        result.emplace_back(std::stoull(line[0].value()), std::move(row));
+    }
+
+    return result;
+}
+
+DistinctFilter::DistinctFilter(const ExecutionSettings& settings) :
+        settings(settings), partitions(partition_count){
+}
+
+size_t DistinctFilter::estimate_row_bytes(const TableRow& row){
+    return sizeof(TableRow) + row.size() * sizeof(Cell) + hash_entry_overhead;
+}
+
+Table DistinctFilter::add(Table batch){
+    const auto& rows = batch.get_rows();
+    BoolVector keep(false, rows.size());
+
+    for(size_t i = 0; i < rows.size(); ++i, ++position){
+        size_t partition_index = hash_combine(TableRowHash()(rows[i]), partition_salt) % partition_count;
+        Partition& partition = partitions[partition_index];
+
+        if(partition.seen.has_value()){
+            // decided only at the end, when the rows seen before are read back
+            if(!partition.pending.has_value()){
+                partition.pending.emplace(settings.spill_directory);
+            }
+            partition.pending->write(position, rows[i]);
+            continue;
+        }
+
+        if(!partition.rows.insert(rows[i]).second){
+            continue;
+        }
+
+        keep[i] = true;
+        ++passed_count;
+
+        if(passed_before_spill.has_value()){
+            passed_positions.push_back(position);
+        }
+
+        size_t bytes = estimate_row_bytes(rows[i]);
+        partition.bytes += bytes;
+        memory += bytes;
+
+        while(memory > settings.memory_budget){
+            auto largest = std::ranges::max_element(partitions, {}, &Partition::bytes);
+
+            if(largest->bytes == 0){
+                break;
+            }
+
+            spill(largest - partitions.begin());
+        }
+    }
+
+    batch.keep_rows(keep);
+
+    return batch;
+}
+
+void DistinctFilter::spill(size_t partition_index){
+    Partition& partition = partitions[partition_index];
+
+    if(!passed_before_spill.has_value()){
+        passed_before_spill = passed_count;
+    }
+
+    if(!partition.seen.has_value()){
+        partition.seen.emplace(settings.spill_directory);
+    }
+
+    for(const auto& row : partition.rows){
+        partition.seen->write(0, row);
+    }
+
+    memory -= partition.bytes;
+    partition.bytes = 0;
+    partition.rows = {};
+}
+
+void DistinctFilter::finish(Table& passed){
+    if(!passed_before_spill.has_value()){
+        return;
+    }
+
+    // rows of the spilled partitions seen for the first time as pairs (position, row)
+    std::vector<std::pair<size_t, TableRow>> found;
+
+    for(auto& partition : partitions){
+        if(!partition.seen.has_value()){
+            continue;
+        }
+
+        std::unordered_set<TableRow, TableRowHash, TableRowIdentical> seen_rows;
+
+        for(auto& [position, row] : partition.seen->read()){
+            seen_rows.insert(std::move(row));
+        }
+
+        if(partition.pending.has_value()){
+            for(auto& [position, row] : partition.pending->read()){
+                if(seen_rows.insert(row).second){
+                    found.emplace_back(position, std::move(row));
+                }
+            }
+        }
+
+        partition.seen.reset();
+        partition.pending.reset();
+    }
+
+    if(found.empty()){
+        return;
+    }
+
+    std::ranges::sort(found, {}, &std::pair<size_t, TableRow>::first);
+
+    // the passed rows and the found rows are merged by their positions
+    const auto& passed_rows = passed.get_rows();
+    size_t before = passed_before_spill.value();
+
+    std::vector<TableRow> rows(passed_rows.begin(), passed_rows.begin() + before);
+    rows.reserve(passed_rows.size() + found.size());
+
+    size_t next_passed = before;
+    size_t next_found = 0;
+
+    while(next_passed < passed_rows.size() || next_found < found.size()){
+        bool take_passed = next_found == found.size() ||
+            (next_passed < passed_rows.size() && passed_positions[next_passed - before] < found[next_found].first);
+
+        if(take_passed){
+            rows.push_back(passed_rows[next_passed++]);
+        } else {
+            rows.push_back(std::move(found[next_found++].second));
+        }
+    }
+
+    passed = Table(passed.get_header(), std::move(rows));
+}
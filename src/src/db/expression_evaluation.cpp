@@ -1,20 +1,9 @@
 #include "db/expression_evaluation.h"
+#include "db/cell_set.h"
 #include "parse/token_to_cell.h"
 
-#include <set>
 #include <algorithm>
 
-template <class C>
-static C get_distinct(const C& values){
-    std::set values_set(std::begin(values), std::end(values));
-    
-    C result(values_set.size());
-    
-    std::copy(std::begin(values_set), std::end(values_set), std::begin(result));
-    
-    return result;
-}
-
 static bool is_aggregate(const Token& token){
     static const std::vector<std::string> aggregates = {"MIN", "MAX", "SUM", "AVG"};
 
@@ -42,19 +31,19 @@ std::unique_ptr<ExpressionNode> ExpressionEvaluation::parse_count() {
     }
     size_t column_index = descriptor->index;
     
-    std::vector<Cell> cells_in_column;
+    // the column is counted right from the rows
+    size_t count = 0;
+    DistinctValues distinct_values;
     
     for(auto&& row : table.get_rows()){
-        if(row[column_index].type() != Cell::DataType::Null){
-            cells_in_column.push_back(row[column_index]);
+        const Cell& cell = row[column_index];
+        
+        if(cell.type() != Cell::DataType::Null && (!distinct || distinct_values.insert(cell))){
+            ++count;
         }
     }
     
-    if(distinct){
-        cells_in_column=get_distinct(cells_in_column);
-    }
-    
-    return std::make_unique<ConstantNode>(Cell((int)cells_in_column.size(), Cell::DataType::Int));
+    return std::make_unique<ConstantNode>(Cell((int)count, Cell::DataType::Int));
 }
 
 std::unique_ptr<ExpressionNode> ExpressionEvaluation::parse_aggregate(){
@@ -71,11 +60,7 @@ std::unique_ptr<ExpressionNode> ExpressionEvaluation::parse_aggregate(){
         return std::make_unique<ConstantNode>(Cell());
     }
     
-    if(is_distinct){
-        column_values = get_distinct(column_values);
-    }
-    
-    
+    // DISTINCT doesn't change the extremes
     if(aggregate_type.like("MAX")){
         return std::make_unique<ConstantNode>(column_values.max());
     }
@@ -83,14 +68,20 @@ std::unique_ptr<ExpressionNode> ExpressionEvaluation::parse_aggregate(){
         return std::make_unique<ConstantNode>(column_values.min());
     }
     
+    Cell result;
+    size_t count = 0;
+    DistinctValues distinct_values;
     
-    Cell result = column_values[0];
-    for(size_t i = 1; i < column_values.size(); ++i){
-        result += column_values[i];
+    for(const Cell& value : column_values){
+        if(is_distinct && !distinct_values.insert(value)){
+            continue;
+        }
+        
+        result = count++ == 0 ? value : result + value;
     }
     
     if(aggregate_type.like("AVG")){
-        result /= Cell((int)column_values.size(), Cell::DataType::Int);
+        result /= Cell((int)count, Cell::DataType::Int);
     }
     
     return std::make_unique<ConstantNode>(result);
@@ -184,8 +175,12 @@ std::unique_ptr<ExpressionNode> ExpressionEvaluation::parse_additive_expression(
     return result;
 }
 
+std::unique_ptr<ExpressionNode> ExpressionEvaluation::parse() {
+    return parse_additive_expression();
+}
+
 EvaluatedExpression ExpressionEvaluation::evaluate() {
-    auto tree = parse_additive_expression();
+    auto tree = parse();
     
     CellVector result(table.get_rows().size());
     for(size_t row_index = 0; row_index < table.get_rows().size(); ++row_index){
@@ -198,7 +193,8 @@ EvaluatedExpression ExpressionEvaluation::evaluate() {
         result[row_index] = tree->evaluate(new_variables);
     }
     
-    BoundRow dummy_row(table.get_header(), TableRow(table.get_header().column_count()));
+    TableRow dummy_cells(table.get_header().column_count());
+    BoundRow dummy_row(table.get_header(), dummy_cells);
     auto type = tree->get_type(variables + dummy_row);
     
     return {type, std::move(result)};
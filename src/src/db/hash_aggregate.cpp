@@ -0,0 +1,413 @@
+#include "db/hash_aggregate.h"
+#include "db/exceptions.h"
+#include "db/expression_evaluation.h"
+#include "jobs/worker_pool.h"
+#include "parse/select_clauses.h"
+
+#include <algorithm>
+#include <bit>
+#include <stdexcept>
+#include <unordered_map>
+
+/**
+ * @brief Split a string into tokens
+ */
+static std::vector<Token> read_tokens(const std::string& text){
+    TokenStream stream(text);
+    std::vector<Token> tokens;
+
+    while(!stream.empty()){
+        tokens.push_back(stream.get_token());
+    }
+
+    return tokens;
+}
+
+static bool is_aggregate_function(const Token& token){
+    static const std::vector<std::string> functions = {"COUNT", "SUM", "AVG", "MIN", "MAX"};
+
+    return token.get_type() == TokenType::Identifier && std::ranges::any_of(functions, [&](const std::string& function){
+        return token.like(function);
+    });
+}
+
+static bool is_bracket(const Token& token, const std::string& bracket){
+    return token == Token(TokenType::SpecialChar, bracket);
+}
+
+/**
+ * @brief Find the bracket closing the one at `begin`
+ * @throws InvalidQuery if it isn't closed
+ */
+static size_t find_closing_bracket(const std::vector<Token>& tokens, size_t begin){
+    size_t depth = 0;
+
+    for(size_t i = begin; i < tokens.size(); ++i){
+        if(is_bracket(tokens[i], "(")){
+            ++depth;
+        }
+        else if(is_bracket(tokens[i], ")") && --depth == 0){
+            return i;
+        }
+    }
+
+    throw InvalidQuery("Missing closing bracket");
+}
+
+HashAggregate::HashAggregate(TableHeader header, const std::vector<std::string>& group_by,
+        const std::vector<std::string>& expressions, const VariableList& variables, const ExecutionSettings& settings) :
+        header(std::move(header)), variables(variables), settings(settings){
+
+    for(const auto& column : group_by){
+        auto descriptor = this->header.get_column_info(column);
+
+        if(!descriptor.has_value()){
+            throw InvalidQuery("Grouping by non-existent column " + column);
+        }
+
+        group_columns.push_back(descriptor->index);
+    }
+
+    for(const auto& expression : expressions){
+        auto tokens = read_tokens(expression);
+
+        for_each_call(tokens, [&](size_t begin, size_t end){
+            std::vector<Token> call(tokens.begin() + begin, tokens.begin() + end);
+            std::string text = tokens_to_string(call);
+
+            if(!call_ids.contains(text)){
+                call_ids.emplace(text, calls.size());
+                calls.push_back(parse_call(call));
+            }
+        });
+    }
+}
+
+void HashAggregate::for_each_call(const std::vector<Token>& tokens, const std::function<void(size_t, size_t)>& callback){
+    for(size_t i = 0; i < tokens.size(); ++i){
+        bool opens = i + 1 < tokens.size() && is_bracket(tokens[i + 1], "(");
+
+        if(is_bracket(tokens[i], "(") && i + 1 < tokens.size() && tokens[i + 1].like("SELECT")){
+            // the calls of a subquery aggregate its own rows
+            i = find_closing_bracket(tokens, i);
+        }
+        else if(is_aggregate_function(tokens[i]) && opens){
+            size_t end = find_closing_bracket(tokens, i + 1) + 1;
+            callback(i, end);
+            i = end - 1;
+        }
+    }
+}
+
+HashAggregate::Call HashAggregate::parse_call(const std::vector<Token>& tokens) const {
+    TokenStream stream(tokens_to_string(tokens));
+    Token function = stream.get_token();
+    stream.ignore_token("(");
+
+    Call call{};
+
+    if(function.like("COUNT")){
+        call.type = Cell::DataType::Int;
+
+        if(stream.try_ignore_token("*")){
+            call.function = Function::CountAll;
+        }
+        else {
+            call.function = Function::Count;
+            call.distinct = stream.try_ignore_token("DISTINCT");
+            stream.try_ignore_token("ALL"); // ALL is the default so does nothing
+
+            std::string column = stream.get_token(TokenType::Identifier);
+            auto descriptor = header.get_column_info(column);
+
+            if(!descriptor.has_value()){
+                throw InvalidQuery("Unknown column " + column);
+            }
+            call.column = descriptor->index;
+        }
+    }
+    else {
+        call.distinct = stream.try_ignore_token("DISTINCT");
+
+        Table empty(header);
+        ExpressionEvaluation evaluation(empty, stream, variables);
+        call.argument = evaluation.parse();
+
+        TableRow dummy_cells(header.column_count());
+        BoundRow dummy_row(header, dummy_cells);
+        call.type = call.argument->get_type(variables + dummy_row);
+
+        if(function.like("SUM")){
+            call.function = Function::Sum;
+        }
+        else if(function.like("AVG")){
+            call.function = Function::Avg;
+            call.type = Cell::get_common_type(call.type, Cell::DataType::Int);
+        }
+        else {
+            // DISTINCT doesn't change the extremes
+            call.function = function.like("MIN") ? Function::Min : Function::Max;
+            call.distinct = false;
+        }
+    }
+
+    stream.ignore_token(")");
+    stream.assert_end();
+
+    return call;
+}
+
+void HashAggregate::add(size_t morsel, const Table& rows){
+    bool evaluates_arguments = std::ranges::any_of(calls, [](const Call& call){ return call.argument != nullptr; });
+
+    std::unordered_map<TableRow, size_t, TableRowHash, TableRowIdentical> group_ids;
+    std::vector<Group> groups;
+
+    for(size_t row_index = 0; row_index < rows.get_rows().size(); ++row_index){
+        const TableRow& row = rows.get_rows()[row_index];
+
+        TableRow key;
+        key.reserve(group_columns.size());
+
+        for(size_t column : group_columns){
+            key.push_back(row[column]);
+        }
+
+        auto [position, inserted] = group_ids.try_emplace(key, groups.size());
+
+        if(inserted){
+            size_t hash = group_ids.hash_function()(key);
+            groups.push_back(Group{std::move(key), hash, {morsel, row_index}, row, std::vector<Accumulator>(calls.size())});
+        }
+
+        Group& group = groups[position->second];
+
+        std::optional<VariableList> row_variables;
+        if(evaluates_arguments){
+            row_variables = variables + BoundRow(header, row);
+        }
+
+        for(size_t i = 0; i < calls.size(); ++i){
+            const Call& call = calls[i];
+
+            if(call.function == Function::CountAll){
+                ++group.accumulators[i].count;
+            }
+            else if(call.function == Function::Count){
+                accumulate(call, group.accumulators[i], row[call.column]);
+            }
+            else {
+                accumulate(call, group.accumulators[i], call.argument->evaluate(row_variables.value()));
+            }
+        }
+    }
+
+    auto lock = std::lock_guard(mutex);
+    morsel_groups.emplace(morsel, std::move(groups));
+}
+
+size_t HashAggregate::get_partition_count(size_t group_count) const {
+    size_t group_bytes = sizeof(Group) + calls.size() * sizeof(Accumulator)
+        + (group_columns.size() + header.column_count()) * sizeof(Cell) + 4 * sizeof(void*);
+
+    size_t partitions = std::bit_ceil(group_count * group_bytes / std::max<size_t>(settings.cache_bytes, 1) + 1);
+
+    return std::min(partitions, max_partitions);
+}
+
+std::vector<HashAggregate::Group> HashAggregate::merge_groups(){
+    std::vector<std::vector<Group>> morsels;
+    size_t group_count = 0;
+
+    for(auto& [morsel, groups] : morsel_groups){
+        group_count += groups.size();
+        morsels.push_back(std::move(groups));
+    }
+    morsel_groups.clear();
+
+    if(morsels.size() == 1){
+        return std::move(morsels[0]);
+    }
+
+    size_t partition_count = get_partition_count(group_count);
+
+    // the groups of each morsel are split by the partitions first, so that a partition doesn't scan all the groups
+    std::vector<std::vector<std::vector<size_t>>> partitioned(morsels.size(), std::vector<std::vector<size_t>>(partition_count));
+
+    WorkerPool::get_shared().parallel_for(morsels.size(), 1, [&](size_t begin, size_t end){
+        for(size_t morsel = begin; morsel < end; ++morsel){
+            for(size_t group = 0; group < morsels[morsel].size(); ++group){
+                partitioned[morsel][morsels[morsel][group].hash % partition_count].push_back(group);
+            }
+        }
+    });
+
+    std::vector<std::vector<Group>> partitions(partition_count);
+
+    WorkerPool::get_shared().parallel_for(partition_count, 1, [&](size_t begin, size_t end){
+        for(size_t partition = begin; partition < end; ++partition){
+            std::unordered_map<TableRow, size_t, TableRowHash, TableRowIdentical> group_ids;
+            std::vector<Group>& merged = partitions[partition];
+
+            // the morsels are merged in order, so the first group with a key has the first row
+            for(size_t morsel = 0; morsel < morsels.size(); ++morsel){
+                for(size_t index : partitioned[morsel][partition]){
+                    Group& group = morsels[morsel][index];
+
+                    auto [position, inserted] = group_ids.try_emplace(group.key, merged.size());
+
+                    if(inserted){
+                        merged.push_back(std::move(group));
+                        continue;
+                    }
+
+                    Group& target = merged[position->second];
+                    for(size_t i = 0; i < calls.size(); ++i){
+                        merge(calls[i], target.accumulators[i], std::move(group.accumulators[i]));
+                    }
+                }
+            }
+        }
+    });
+
+    std::vector<Group> groups;
+    groups.reserve(group_count);
+
+    for(auto& partition : partitions){
+        groups.insert(groups.end(), std::make_move_iterator(partition.begin()), std::make_move_iterator(partition.end()));
+    }
+
+    std::ranges::sort(groups, {}, &Group::origin);
+
+    return groups;
+}
+
+void HashAggregate::combine(Function function, std::optional<Cell>& target, const Cell& value){
+    if(!target.has_value()){
+        target = value;
+        return;
+    }
+
+    switch(function){
+        case Function::Sum:
+        case Function::Avg:
+            *target += value;
+            break;
+        case Function::Min:
+            if(value < *target){
+                target = value;
+            }
+            break;
+        case Function::Max:
+            if(value > *target){
+                target = value;
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+void HashAggregate::accumulate(const Call& call, Accumulator& accumulator, const Cell& value){
+    bool skips_null = call.function == Function::Count || call.function == Function::Min || call.function == Function::Max;
+
+    if(skips_null && value.type() == Cell::DataType::Null){
+        return;
+    }
+
+    if(call.distinct && !accumulator.distinct_values.insert(value)){
+        return;
+    }
+
+    ++accumulator.count;
+
+    if(call.function != Function::Count){
+        combine(call.function, accumulator.value, value);
+    }
+}
+
+void HashAggregate::merge(const Call& call, Accumulator& target, Accumulator&& source){
+    if(call.distinct){
+        // only the values the target hasn't seen are added, in the order they were seen
+        for(const Cell& value : source.distinct_values.get_values()){
+            accumulate(call, target, value);
+        }
+        return;
+    }
+
+    target.count += source.count;
+
+    if(source.value.has_value()){
+        combine(call.function, target.value, source.value.value());
+    }
+}
+
+Cell HashAggregate::finalize(const Call& call, const Accumulator& accumulator){
+    if(call.function == Function::CountAll || call.function == Function::Count){
+        return Cell((int)accumulator.count, Cell::DataType::Int);
+    }
+
+    if(!accumulator.value.has_value()){
+        return Cell();
+    }
+
+    if(call.function == Function::Avg){
+        return *accumulator.value / Cell((int)accumulator.count, Cell::DataType::Int);
+    }
+
+    return *accumulator.value;
+}
+
+std::string HashAggregate::get_column_name(size_t call){
+    return "_aggregate_" + std::to_string(call);
+}
+
+Table HashAggregate::get_groups(){
+    std::vector<std::pair<Cell::DataType, std::string>> columns;
+
+    for(size_t i = 0; i < calls.size(); ++i){
+        columns.emplace_back(calls[i].type, get_column_name(i));
+    }
+
+    auto lock = std::lock_guard(mutex);
+    std::vector<Group> groups = merge_groups();
+
+    std::vector<TableRow> rows;
+    rows.reserve(groups.size());
+
+    for(auto& group : groups){
+        TableRow row = std::move(group.first_row);
+
+        for(size_t i = 0; i < calls.size(); ++i){
+            row.push_back(finalize(calls[i], group.accumulators[i]));
+        }
+
+        rows.push_back(std::move(row));
+    }
+
+    return Table(TableHeader::join(header, TableHeader(std::move(columns))), std::move(rows));
+}
+
+std::string HashAggregate::rewrite(const std::string& expression) const {
+    auto tokens = read_tokens(expression);
+
+    std::vector<Token> result;
+    size_t copied = 0;
+
+    for_each_call(tokens, [&](size_t begin, size_t end){
+        std::vector<Token> call(tokens.begin() + begin, tokens.begin() + end);
+        auto id = call_ids.find(tokens_to_string(call));
+
+        if(id == call_ids.end()){
+            throw std::runtime_error("Aggregate " + tokens_to_string(call) + " was not collected");
+        }
+
+        result.insert(result.end(), tokens.begin() + copied, tokens.begin() + begin);
+        result.emplace_back(TokenType::Identifier, get_column_name(id->second));
+        copied = end;
+    });
+
+    result.insert(result.end(), tokens.begin() + copied, tokens.end());
+
+    return tokens_to_string(result);
+}
@@ -0,0 +1,1183 @@
+#include "db/join.h"
+#include "db/exceptions.h"
+#include "db/subquery.h"
+#include "db/table_index.h"
+#include "parse/select_clauses.h"
+#include "jobs/worker_pool.h"
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <chrono>
+#include <format>
+#include <functional>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <numeric>
+#include <ranges>
+
+/**
+ * @brief Estimated number of bytes a hash table entry takes besides the key
+ */
+static constexpr size_t hash_entry_overhead = 64;
+
+/**
+ * @brief Bounds of the number of temporary files each input of a spilling join is split into
+ */
+static constexpr size_t min_spill_partitions = 4;
+static constexpr size_t max_spill_partitions = 64;
+
+/**
+ * @brief How many times smaller than a table a group must be to look up its rows in an index of the table
+ */
+static constexpr size_t index_join_ratio = 16;
+
+/**
+ * @brief Estimated fraction of the pairs of rows satisfying a band condition
+ */
+static constexpr double band_selectivity = 0.25;
+
+/**
+ * @brief Estimated fraction of the pairs of rows satisfying another condition of two tables
+ */
+static constexpr double theta_selectivity = 1.0 / 3;
+
+/**
+ * @brief Estimated fraction of the rows of a table satisfying its own conditions, if they aren't evaluated
+ */
+static constexpr double filter_selectivity = 1.0 / 3;
+
+/**
+ * @brief Number of rows of the left group in a tile of a nested-loop join
+ */
+static constexpr size_t nested_loop_left_rows = 64;
+
+/**
+ * @brief Number of rows of the right group in a tile of a nested-loop join
+ */
+static constexpr size_t nested_loop_right_rows = 512;
+
+/**
+ * @brief Join conditions by AND into a single one
+ */
+static std::string join_conjuncts(const std::vector<std::vector<Token>>& conjuncts){
+    std::string result;
+
+    for(const auto& conjunct : conjuncts){
+        if(!result.empty()){
+            result += " AND ";
+        }
+        result += "( " + tokens_to_string(conjunct) + " )";
+    }
+
+    return result;
+}
+
+JoinPlanner::JoinPlanner(std::vector<std::pair<const Table&, std::string>> tables, const std::vector<Token>& condition,
+        const std::optional<std::set<std::string>>& referenced_names, const VariableList& variables,
+        SelectCallback& select_callback, const ExecutionSettings& settings, bool plan_only) :
+        tables(std::move(tables)), variables(variables), select_callback(select_callback), settings(settings),
+        plan_only(plan_only), condition(condition) {
+    // columns of each table the statement refers to
+    for(const auto& [table, alias] : this->tables){
+        TableHeader header = table.get_header().add_alias(alias);
+        std::vector<size_t> kept;
+
+        for(const auto& column : header.get_columns()){
+            if(!referenced_names.has_value() || referenced_names->contains(column.name)
+                    || referenced_names->contains(alias + "." + column.name)){
+                kept.push_back(column.index);
+            }
+        }
+
+        headers.push_back(header.select(kept));
+        base_columns.push_back(std::move(kept));
+    }
+
+    // conditions of each table, not worth it for a single table
+    std::vector<std::vector<std::vector<Token>>> filters(this->tables.size());
+    bool has_filters = false;
+
+    if(!condition.empty()){
+        for(auto&& conjunct : split_conjuncts(condition)){
+            if(auto join = get_equi_join(conjunct)){
+                join_conditions.push_back(std::move(join.value()));
+                continue;
+            }
+            if(auto band = get_band_join(conjunct)){
+                join_conditions.push_back(std::move(band.value()));
+                continue;
+            }
+
+            auto referenced_tables = get_referenced_tables(conjunct);
+
+            if(referenced_tables.has_value() && referenced_tables->size() == 1 && this->tables.size() > 1){
+                filters[referenced_tables->front()].push_back(std::move(conjunct));
+                has_filters = true;
+            }
+            else if(referenced_tables.has_value() && referenced_tables->size() == 2){
+                std::pair<size_t, size_t> joined_tables = {referenced_tables->front(), referenced_tables->back()};
+                join_conditions.push_back({ThetaJoin{}, joined_tables, theta_selectivity, std::move(conjunct)});
+            }
+            else{
+                residual.push_back(std::move(conjunct));
+            }
+        }
+    }
+
+    reduces_rows = !join_conditions.empty() || has_filters;
+
+    scan_statistics.resize(this->tables.size());
+    filter_statistics.resize(this->tables.size());
+
+    for(const auto& table_filters : filters){
+        filter_conditions.push_back(join_conjuncts(table_filters));
+        filtered.push_back(!table_filters.empty());
+    }
+
+    versions.resize(this->tables.size());
+
+    // a cross product only copies the referenced columns when it's executed, it may never be
+    if(!reduces_rows){
+        return;
+    }
+
+    for(size_t i = 0; i < this->tables.size(); ++i){
+        if(plan_only){
+            // only the row count of the table is read
+            auto lock = this->tables[i].first.lock_rows();
+            double rows = this->tables[i].first.get_rows().size();
+
+            input_rows.push_back(filtered[i] ? rows * filter_selectivity : rows);
+            continue;
+        }
+
+        inputs.push_back(read_input(i));
+        input_rows.push_back(inputs.back().get_rows().size());
+    }
+
+    used.assign(join_conditions.size(), false);
+
+    // group of joined tables each table belongs to, identified by one of its tables
+    std::vector<size_t> group(this->tables.size());
+    std::iota(group.begin(), group.end(), 0);
+
+    // the tables connected by the conditions are planned together
+    std::vector<size_t> component = group;
+
+    for(const auto& join_condition : join_conditions){
+        auto [left, right] = join_condition.tables;
+        std::ranges::replace(component, component[right], component[left]);
+    }
+
+    std::map<size_t, std::vector<size_t>> components;
+
+    for(size_t i = 0; i < component.size(); ++i){
+        components[component[i]].push_back(i);
+    }
+
+    for(const auto& [id, members] : components){
+        if(members.size() == 1){
+            continue;
+        }
+
+        // the order of two tables is given, so their equalities are estimated only for EXPLAIN
+        if(members.size() > 2){
+            for(auto& join_condition : join_conditions){
+                if(component[join_condition.tables.first] == id && !join_condition.selectivity.has_value()){
+                    join_condition.selectivity = get_selectivity(join_condition);
+                }
+            }
+        }
+
+        if(members.size() <= max_exhaustive_tables){
+            plan_exhaustive(members, group);
+        }
+        else{
+            plan_greedy(members, group);
+        }
+    }
+
+    for(size_t i = 0; i < join_conditions.size(); ++i){
+        if(!used[i]){
+            // the tables were already joined by other conditions
+            residual.push_back(std::move(join_conditions[i].condition));
+        }
+    }
+}
+
+std::optional<JoinPlanner::ColumnReference> JoinPlanner::resolve_column(const std::string& name) const {
+    if(name.empty() || variables.contains(name)){
+        // ambiguous with a variable, left for the condition evaluation to report
+        return std::nullopt;
+    }
+
+    std::optional<ColumnReference> result;
+
+    for(size_t i = 0; i < headers.size(); ++i){
+        std::optional<ColumnDescriptor> column;
+
+        try{
+            column = headers[i].get_column_info(name);
+        }
+        catch(InvalidQuery&){
+            return std::nullopt;
+        }
+
+        if(!column.has_value()){
+            continue;
+        }
+
+        if(result.has_value()){
+            return std::nullopt;
+        }
+
+        result = ColumnReference{i, column->index};
+    }
+
+    return result;
+}
+
+std::optional<std::vector<size_t>> JoinPlanner::get_referenced_tables(const std::vector<Token>& conjunct) const {
+    std::vector<size_t> result;
+
+    for(size_t i = 0; i < conjunct.size(); ++i){
+        if(conjunct[i].like("SELECT")){
+            return std::nullopt;
+        }
+
+        if(conjunct[i].get_type() != TokenType::Identifier){
+            continue;
+        }
+
+        std::string name = conjunct[i].get_value();
+
+        if(i + 2 < conjunct.size() && conjunct[i + 1].like(".")){
+            name += "." + conjunct[i + 2].get_value();
+            i += 2;
+        }
+
+        bool is_column = std::ranges::any_of(headers, [&](const TableHeader& header){
+            try{
+                return header.get_column_info(name).has_value();
+            }
+            catch(InvalidQuery&){
+                return true;
+            }
+        });
+
+        if(!is_column){
+            continue;
+        }
+
+        auto column = resolve_column(name);
+
+        if(!column.has_value()){
+            return std::nullopt;
+        }
+
+        result.push_back(column->table);
+    }
+
+    std::ranges::sort(result);
+    auto [end, last] = std::ranges::unique(result);
+    result.erase(end, last);
+
+    return result;
+}
+
+std::optional<JoinPlanner::JoinCondition> JoinPlanner::get_equi_join(const std::vector<Token>& conjunct) const {
+    auto equals = std::ranges::find_if(conjunct, [](const Token& token){
+        return token.like("=");
+    });
+
+    if(equals == conjunct.end()){
+        return std::nullopt;
+    }
+
+    auto left = resolve_column(tokens_to_column_name({conjunct.begin(), equals}));
+    auto right = resolve_column(tokens_to_column_name({equals + 1, conjunct.end()}));
+
+    if(!left.has_value() || !right.has_value() || left->table == right->table){
+        return std::nullopt;
+    }
+
+    return JoinCondition{
+        EquiJoin{left.value(), right.value()},
+        {left->table, right->table},
+        std::nullopt,   // estimated from the filtered tables when needed
+        conjunct
+    };
+}
+
+std::optional<JoinPlanner::JoinCondition> JoinPlanner::get_band_join(const std::vector<Token>& conjunct) const {
+    auto between = std::ranges::find_if(conjunct, [](const Token& token){
+        return token.like("BETWEEN");
+    });
+
+    if(between == conjunct.end() || between == conjunct.begin() || (between - 1)->like("NOT")){
+        return std::nullopt;
+    }
+
+    auto separator = std::find_if(between, conjunct.end(), [](const Token& token){
+        return token.like("AND");
+    });
+
+    if(separator == conjunct.end()){
+        return std::nullopt;
+    }
+
+    auto value = resolve_column(tokens_to_column_name({conjunct.begin(), between}));
+    auto lower = resolve_column(tokens_to_column_name({between + 1, separator}));
+    auto upper = resolve_column(tokens_to_column_name({separator + 1, conjunct.end()}));
+
+    if(!value.has_value() || !lower.has_value() || !upper.has_value()){
+        return std::nullopt;
+    }
+
+    if(value->table == lower->table || lower->table != upper->table){
+        return std::nullopt;
+    }
+
+    Cell::DataType type = get_type(value.value());
+
+    bool sortable = type == Cell::DataType::Int || type == Cell::DataType::Float || type == Cell::DataType::String;
+
+    if(!sortable || get_type(lower.value()) != type || get_type(upper.value()) != type){
+        return std::nullopt;
+    }
+
+    return JoinCondition{
+        BandJoin{value.value(), lower.value(), upper.value()},
+        {value->table, lower->table},
+        band_selectivity,
+        conjunct
+    };
+}
+
+Cell::DataType JoinPlanner::get_type(const ColumnReference& column) const {
+    return headers[column.table].get_columns()[column.column].type;
+}
+
+ColumnStatistics JoinPlanner::get_column_statistics(const ColumnReference& column) const {
+    size_t table = column.table;
+
+    // the statistics of an unfiltered input are those of its table, which keeps them for later queries
+    if(!filtered[table]){
+        auto statistics = tables[table].first.get_column_statistics(base_columns[table][column.column], versions[table]);
+
+        if(statistics.has_value()){
+            return statistics.value();
+        }
+    }
+
+    return inputs[table].get_column_statistics(column.column);
+}
+
+double JoinPlanner::estimate_equality_selectivity(const ColumnReference& left, const ColumnReference& right) const {
+    if(plan_only){
+        // the values of the larger input are assumed to be distinct, as in a join on a key
+        return 1 / std::max({input_rows[left.table], input_rows[right.table], 1.0});
+    }
+
+    auto left_statistics = get_column_statistics(left);
+    auto right_statistics = get_column_statistics(right);
+
+    // each value of the column with fewer distinct values is assumed to appear in the other one
+    size_t distinct_values = std::max({left_statistics.distinct_values, right_statistics.distinct_values, size_t(1)});
+
+    return left_statistics.non_null_fraction * right_statistics.non_null_fraction / distinct_values;
+}
+
+double JoinPlanner::get_selectivity(const JoinCondition& join_condition) const {
+    if(join_condition.selectivity.has_value()){
+        return join_condition.selectivity.value();
+    }
+
+    const auto& join = std::get<EquiJoin>(join_condition.join);
+
+    return estimate_equality_selectivity(join.left, join.right);
+}
+
+double JoinPlanner::estimate_rows(const std::vector<bool>& members) const {
+    double rows = 1;
+
+    for(size_t i = 0; i < tables.size(); ++i){
+        if(members[i]){
+            rows *= input_rows[i];
+        }
+    }
+
+    for(const auto& join_condition : join_conditions){
+        if(members[join_condition.tables.first] && members[join_condition.tables.second]){
+            rows *= get_selectivity(join_condition);
+        }
+    }
+
+    return rows;
+}
+
+bool JoinPlanner::connects(size_t left, size_t right, const std::vector<size_t>& group) const {
+    for(size_t i = 0; i < join_conditions.size(); ++i){
+        auto groups = std::minmax(group[join_conditions[i].tables.first], group[join_conditions[i].tables.second]);
+
+        if(!used[i] && groups == std::minmax(left, right)){
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void JoinPlanner::add_step(size_t left, size_t right, std::vector<size_t>& group){
+    Step step{left, right, {}, std::nullopt, {}, "", {}};
+
+    std::vector<size_t> between;
+
+    for(size_t i = 0; i < join_conditions.size(); ++i){
+        auto groups = std::minmax(group[join_conditions[i].tables.first], group[join_conditions[i].tables.second]);
+
+        if(!used[i] && groups == std::minmax(left, right)){
+            between.push_back(i);
+        }
+    }
+
+    // all the equalities form a single key, a band is used only without them
+    for(size_t i : between){
+        if(const auto* join = std::get_if<EquiJoin>(&join_conditions[i].join)){
+            step.keys.push_back(*join);
+            used[i] = true;
+        }
+    }
+
+    for(size_t i : between){
+        if(!step.keys.empty() || step.band.has_value()){
+            break;
+        }
+        if(const auto* band = std::get_if<BandJoin>(&join_conditions[i].join)){
+            step.band = *band;
+            used[i] = true;
+        }
+    }
+
+    // the other conditions need a nested-loop join, which evaluates all of them at once
+    for(size_t i : between){
+        if(!step.keys.empty() || step.band.has_value()){
+            break;
+        }
+        if(std::holds_alternative<ThetaJoin>(join_conditions[i].join)){
+            step.predicates.push_back(join_conditions[i].condition);
+            used[i] = true;
+        }
+    }
+
+    std::vector<std::vector<Token>> step_conditions;
+    std::vector<bool> members(tables.size());
+
+    for(size_t i : between){
+        if(used[i]){
+            step_conditions.push_back(join_conditions[i].condition);
+        }
+    }
+    for(size_t i = 0; i < tables.size(); ++i){
+        members[i] = group[i] == left || group[i] == right;
+    }
+
+    step.description = join_conjuncts(step_conditions);
+    step.members = std::move(members);
+
+    steps.push_back(std::move(step));
+
+    std::ranges::replace(group, right, left);
+}
+
+void JoinPlanner::plan_exhaustive(const std::vector<size_t>& component, std::vector<size_t>& group){
+    size_t count = component.size();
+    size_t full_set = (size_t(1) << count) - 1;
+
+    auto get_members = [&](size_t set){
+        std::vector<bool> members(tables.size());
+        for(size_t i = 0; i < count; ++i){
+            members[component[i]] = (set >> i) & 1;
+        }
+        return members;
+    };
+
+    // the tables of each condition as a set of positions in the component
+    std::vector<size_t> condition_sets;
+
+    for(const auto& join_condition : join_conditions){
+        size_t set = 0;
+        for(size_t i = 0; i < count; ++i){
+            if(component[i] == join_condition.tables.first || component[i] == join_condition.tables.second){
+                set |= size_t(1) << i;
+            }
+        }
+        condition_sets.push_back(set);
+    }
+
+    constexpr double unreachable = std::numeric_limits<double>::infinity();
+
+    std::vector<double> cost(full_set + 1, unreachable);
+    std::vector<size_t> split(full_set + 1);
+
+    for(size_t set = 1; set <= full_set; ++set){
+        if(std::popcount(set) == 1){
+            cost[set] = 0;
+            continue;
+        }
+
+        double rows = estimate_rows(get_members(set));
+        size_t lowest = set & -set;
+
+        // the part containing the lowest table is on the left, so that each split is tried once
+        for(size_t left = (set - 1) & set; left != 0; left = (left - 1) & set){
+            size_t right = set ^ left;
+
+            if(!(left & lowest) || cost[left] == unreachable || cost[right] == unreachable){
+                continue;
+            }
+
+            bool connected = std::ranges::any_of(condition_sets, [&](size_t condition_set){
+                return (condition_set & left) && (condition_set & right) && (condition_set & ~set) == 0;
+            });
+
+            if(!connected){
+                continue;
+            }
+
+            double total = cost[left] + cost[right] + rows;
+
+            if(total < cost[set]){
+                cost[set] = total;
+                split[set] = left;
+            }
+        }
+    }
+
+    std::function<size_t(size_t)> add_steps = [&](size_t set) -> size_t {
+        if(std::popcount(set) == 1){
+            return component[std::countr_zero(set)];
+        }
+
+        size_t left = add_steps(split[set]);
+        size_t right = add_steps(set ^ split[set]);
+
+        add_step(left, right, group);
+
+        return left;
+    };
+
+    add_steps(full_set);
+}
+
+void JoinPlanner::plan_greedy(const std::vector<size_t>& component, std::vector<size_t>& group){
+    std::vector<size_t> groups = component;
+
+    while(groups.size() > 1){
+        std::optional<std::pair<size_t, size_t>> best;
+        double best_rows = 0;
+
+        for(size_t i = 0; i < groups.size(); ++i){
+            for(size_t j = i + 1; j < groups.size(); ++j){
+                if(!connects(groups[i], groups[j], group)){
+                    continue;
+                }
+
+                std::vector<bool> members(tables.size());
+                for(size_t table = 0; table < tables.size(); ++table){
+                    members[table] = group[table] == groups[i] || group[table] == groups[j];
+                }
+
+                double rows = estimate_rows(members);
+
+                if(!best.has_value() || rows < best_rows){
+                    best = {i, j};
+                    best_rows = rows;
+                }
+            }
+        }
+
+        if(!best.has_value()){
+            break;
+        }
+
+        add_step(groups[best->first], groups[best->second], group);
+
+        groups.erase(groups.begin() + best->second);
+    }
+}
+
+void JoinPlanner::for_each_key(const Group& group, const std::vector<ColumnReference>& columns,
+        const std::vector<Cell::DataType>& types, const std::function<void(size_t, std::optional<TableRow>)>& callback) const {
+    std::vector<size_t> positions;
+
+    for(const auto& column : columns){
+        positions.push_back(std::ranges::find(group.members, column.table) - group.members.begin());
+    }
+
+    for(size_t row = 0; row < group.row_count(); ++row){
+        TableRow key;
+        key.reserve(columns.size());
+
+        for(size_t i = 0; i < columns.size(); ++i){
+            size_t row_id = group.row_ids[row * group.members.size() + positions[i]];
+            Cell cell = inputs[columns[i].table].get_rows()[row_id][columns[i].column].convert(types[i]);
+
+            if(cell.type() == Cell::DataType::Null){
+                break;
+            }
+
+            key.push_back(std::move(cell));
+        }
+
+        if(key.size() == columns.size()){
+            callback(row, std::move(key));
+        }
+        else{
+            callback(row, std::nullopt);
+        }
+    }
+}
+
+JoinKeys JoinPlanner::get_keys(const Group& group, const std::vector<ColumnReference>& columns,
+        const std::vector<Cell::DataType>& types) const {
+    JoinKeys keys;
+    keys.reserve(group.row_count());
+
+    for_each_key(group, columns, types, [&](size_t, std::optional<TableRow> key){
+        keys.push_back(std::move(key));
+    });
+
+    return keys;
+}
+
+bool JoinPlanner::can_use_index(const Group& inner, const Group& outer) const {
+    return inner.members.size() == 1 && !filtered[inner.members[0]]
+        && outer.row_count() * index_join_ratio <= inner.row_count();
+}
+
+std::optional<JoinPairs> JoinPlanner::index_join(const Group& left, const Group& right,
+        const std::vector<ColumnReference>& left_columns, const std::vector<ColumnReference>& right_columns,
+        const std::vector<Cell::DataType>& types) const {
+    bool inner_right = can_use_index(right, left);
+
+    if(!inner_right && !can_use_index(left, right)){
+        return std::nullopt;
+    }
+
+    const Group& inner = inner_right ? right : left;
+    const Group& outer = inner_right ? left : right;
+    const auto& inner_columns = inner_right ? right_columns : left_columns;
+    const auto& outer_columns = inner_right ? left_columns : right_columns;
+
+    size_t table = inner.members[0];
+
+    std::vector<size_t> indexed_columns;
+    for(const auto& column : inner_columns){
+        indexed_columns.push_back(base_columns[table][column.column]);
+    }
+
+    // the rows of the input are the rows of the table only if it didn't change since they were copied
+    auto index = tables[table].first.get_index(IndexKind::Hash, indexed_columns, types, versions[table]);
+
+    if(index == nullptr){
+        return std::nullopt;
+    }
+
+    JoinPairs pairs;
+    std::vector<size_t> matches;
+
+    for_each_key(outer, outer_columns, types, [&](size_t row, std::optional<TableRow> key){
+        if(!key.has_value()){
+            return;
+        }
+
+        matches.clear();
+        index->find_equal(key.value(), matches);
+
+        for(size_t match : matches){
+            pairs.push_back(inner_right ? std::pair{row, match} : std::pair{match, row});
+        }
+    });
+
+    return pairs;
+}
+
+std::optional<JoinPairs> JoinPlanner::index_band_join(const Group& values, const Group& bounds, const BandJoin& band) const {
+    if(!can_use_index(values, bounds)){
+        return std::nullopt;
+    }
+
+    size_t table = values.members[0];
+    Cell::DataType type = get_type(band.value);
+
+    auto index = tables[table].first.get_index(IndexKind::Ordered, {base_columns[table][band.value.column]}, {type},
+        versions[table]);
+
+    if(index == nullptr){
+        return std::nullopt;
+    }
+
+    JoinPairs pairs;
+    std::vector<size_t> matches;
+
+    for_each_key(bounds, {band.lower, band.upper}, {type, type}, [&](size_t row, std::optional<TableRow> key){
+        if(!key.has_value()){
+            return;
+        }
+
+        matches.clear();
+        index->find_range(key.value()[0], key.value()[1], matches);
+
+        for(size_t match : matches){
+            pairs.emplace_back(match, row);
+        }
+    });
+
+    return pairs;
+}
+
+JoinPairs JoinPlanner::join_on_keys(const Group& left, const Group& right, const std::vector<ColumnReference>& left_columns,
+        const std::vector<ColumnReference>& right_columns, const std::vector<Cell::DataType>& types,
+        std::string& algorithm) const {
+    if(auto pairs = index_join(left, right, left_columns, right_columns, types)){
+        algorithm = "IndexJoin";
+        return std::move(pairs.value());
+    }
+
+    size_t build_rows = std::min(left.row_count(), right.row_count());
+    size_t hash_table_size = build_rows * (sizeof(TableRow) + types.size() * sizeof(Cell) + hash_entry_overhead);
+
+    if(hash_table_size > settings.memory_budget){
+        // each pair of partitions should fit into the budget
+        size_t partition_count = std::clamp(hash_table_size / std::max(settings.memory_budget, size_t(1)) + 1,
+            min_spill_partitions, max_spill_partitions);
+
+        KeyPartitions left_partitions(partition_count, types, settings.spill_directory);
+        KeyPartitions right_partitions(partition_count, types, settings.spill_directory);
+
+        for_each_key(left, left_columns, types, [&](size_t row, std::optional<TableRow> key){
+            left_partitions.add(row, key);
+        });
+        for_each_key(right, right_columns, types, [&](size_t row, std::optional<TableRow> key){
+            right_partitions.add(row, key);
+        });
+
+        algorithm = "GraceHashJoin";
+        return grace_hash_join_pairs(left_partitions, right_partitions);
+    }
+
+    JoinKeys left_keys = get_keys(left, left_columns, types);
+    JoinKeys right_keys = get_keys(right, right_columns, types);
+
+    if(keys_sorted(left_keys) && keys_sorted(right_keys)){
+        algorithm = "MergeJoin";
+        return merge_join_pairs(left_keys, right_keys);
+    }
+
+    algorithm = "HashJoin";
+    return hash_join_pairs(left_keys, right_keys);
+}
+
+JoinPairs JoinPlanner::nested_loop_join(const Group& left, const Group& right,
+        const std::vector<std::vector<Token>>& predicates) const {
+    std::string predicate = join_conjuncts(predicates);
+
+    size_t left_tiles = (left.row_count() + nested_loop_left_rows - 1) / nested_loop_left_rows;
+
+    // the matches of each tile of the left group, concatenated in order at the end
+    std::vector<JoinPairs> tile_matches(left_tiles);
+
+    WorkerPool::get_shared().parallel_for(left_tiles, 1, [&](size_t begin, size_t end){
+        for(size_t tile = begin; tile < end; ++tile){
+            size_t left_begin = tile * nested_loop_left_rows;
+            size_t left_end = std::min(left_begin + nested_loop_left_rows, left.row_count());
+
+            for(size_t right_begin = 0; right_begin < right.row_count(); right_begin += nested_loop_right_rows){
+                size_t right_end = std::min(right_begin + nested_loop_right_rows, right.row_count());
+
+                JoinPairs candidates;
+                candidates.reserve((left_end - left_begin) * (right_end - right_begin));
+
+                for(size_t i = left_begin; i < left_end; ++i){
+                    for(size_t j = right_begin; j < right_end; ++j){
+                        candidates.emplace_back(i, j);
+                    }
+                }
+
+                Table tile_table = materialize(combine_groups(left, right, candidates));
+
+                TokenStream stream(predicate);
+                BoolVector matches = tile_table.evaluate_condition(stream, variables, select_callback);
+                stream.assert_end();
+
+                for(size_t k = 0; k < candidates.size(); ++k){
+                    if(matches[k]){
+                        tile_matches[tile].push_back(candidates[k]);
+                    }
+                }
+            }
+        }
+    });
+
+    JoinPairs result;
+
+    for(auto& matches : tile_matches){
+        result.append_range(matches);
+    }
+
+    return result;
+}
+
+JoinPlanner::Group JoinPlanner::combine_groups(const Group& left, const Group& right, const JoinPairs& pairs){
+    Group result{left.members, {}};
+    result.members.append_range(right.members);
+    result.row_ids.reserve(pairs.size() * result.members.size());
+
+    for(auto [left_row, right_row] : pairs){
+        auto left_ids = left.row_ids.begin() + left_row * left.members.size();
+        auto right_ids = right.row_ids.begin() + right_row * right.members.size();
+
+        result.row_ids.insert(result.row_ids.end(), left_ids, left_ids + left.members.size());
+        result.row_ids.insert(result.row_ids.end(), right_ids, right_ids + right.members.size());
+    }
+
+    return result;
+}
+
+Table JoinPlanner::materialize(const Group& group) const {
+    std::vector<const Table*> member_inputs;
+
+    for(size_t member : group.members){
+        member_inputs.push_back(&inputs[member]);
+    }
+
+    return Table::combine_rows(member_inputs, group.row_ids);
+}
+
+Table JoinPlanner::read_input(size_t table){
+    size_t morsel_rows = std::max(settings.batch_rows, size_t(1));
+
+    std::vector<std::optional<Table>> morsels;
+    std::mutex statistics_mutex;
+
+    {
+        // one lock for all the morsels, so that they are parts of the same rows
+        auto lock = tables[table].first.lock_rows();
+        versions[table] = tables[table].first.get_version();
+
+        size_t morsel_count = std::max((tables[table].first.get_rows().size() + morsel_rows - 1) / morsel_rows, size_t(1));
+        morsels.resize(morsel_count);
+
+        WorkerPool::get_shared().parallel_for(morsel_count, 1, [&](size_t begin, size_t end){
+            for(size_t i = begin; i < end; ++i){
+                OperatorStatistics scan;
+
+                auto start = std::chrono::steady_clock::now();
+                Table morsel = tables[table].first.select_locked_columns(headers[table], base_columns[table],
+                    i * morsel_rows, morsel_rows);
+                scan.add_time(start);
+                scan.set_output(morsel);
+
+                auto statistics_lock = std::lock_guard(statistics_mutex);
+                scan_statistics[table].add(scan);
+                morsels[i] = std::move(morsel);
+            }
+        });
+    }
+
+    // the conditions are evaluated without the lock, their subqueries may read the same table
+    if(filtered[table]){
+        SubqueryCaches subquery_caches;
+
+        WorkerPool::get_shared().parallel_for(morsels.size(), 1, [&](size_t begin, size_t end){
+            for(size_t i = begin; i < end; ++i){
+                OperatorStatistics filter;
+
+                auto start = std::chrono::steady_clock::now();
+                TokenStream stream(filter_conditions[table]);
+                morsels[i]->filter_by_condition(stream, variables, select_callback, false, &subquery_caches);
+                stream.assert_end();
+                filter.add_time(start);
+                filter.set_output(morsels[i].value());
+
+                auto statistics_lock = std::lock_guard(statistics_mutex);
+                filter_statistics[table].add(filter);
+            }
+        });
+    }
+
+    Table result = std::move(morsels.front().value());
+
+    for(auto& morsel : morsels | std::views::drop(1)){
+        result.vertical_join(std::move(morsel.value()));
+    }
+
+    return result;
+}
+
+/**
+ * @brief Estimate the number of bytes taken by the pairs and the row indexes of a join
+ */
+static size_t estimate_join_bytes(size_t pair_count, size_t row_id_count){
+    return pair_count * sizeof(std::pair<size_t, size_t>) + row_id_count * sizeof(size_t);
+}
+
+void JoinPlanner::produce_batches(size_t row_count, const std::function<Table(size_t, size_t)>& make_batch,
+        const BatchConsumer& consumer){
+    size_t batch_rows = std::max(settings.batch_rows, size_t(1));
+    size_t batch_count = std::max((row_count + batch_rows - 1) / batch_rows, size_t(1));
+
+    std::mutex statistics_mutex;
+
+    WorkerPool::get_shared().parallel_for(batch_count, 1, [&](size_t begin, size_t end){
+        for(size_t i = begin; i < end && !stopped; ++i){
+            OperatorStatistics statistics;
+
+            auto start = std::chrono::steady_clock::now();
+            Table batch = make_batch(i * batch_rows, std::min(batch_rows, row_count - std::min(row_count, i * batch_rows)));
+            statistics.add_time(start);
+            statistics.add_batch(batch);
+
+            {
+                auto lock = std::lock_guard(statistics_mutex);
+                materialize_statistics.add(statistics);
+            }
+
+            consumer(i, std::move(batch));
+        }
+    });
+}
+
+void JoinPlanner::execute(const BatchConsumer& consumer){
+    assert(!plan_only);
+
+    if(!reduces_rows){
+        // the positions of the rows in the product depend on the row counts, which must not change between batches
+        std::vector<std::pair<const Table&, std::string>> copies;
+
+        for(size_t i = 0; i < tables.size(); ++i){
+            inputs.push_back(read_input(i));
+        }
+        for(size_t i = 0; i < tables.size(); ++i){
+            copies.emplace_back(inputs[i], tables[i].second);
+        }
+
+        produce_batches(Table::cross_product_size(copies), [&copies](size_t first_row, size_t row_count){
+            return Table::cross_product(copies, first_row, row_count);
+        }, consumer);
+
+        return;
+    }
+
+    std::map<size_t, Group> groups;
+    std::vector<size_t> group(tables.size());
+
+    for(size_t i = 0; i < tables.size(); ++i){
+        std::vector<size_t> row_ids(inputs[i].get_rows().size());
+        std::iota(row_ids.begin(), row_ids.end(), 0);
+
+        groups.emplace(i, Group{{i}, std::move(row_ids)});
+        group[i] = i;
+    }
+
+    for(const auto& step : steps){
+        Group& left = groups.at(step.left);
+        const Group& right = groups.at(step.right);
+
+        auto start = std::chrono::steady_clock::now();
+        std::string algorithm;
+        JoinPairs pairs;
+
+        if(!step.predicates.empty()){
+            algorithm = "NestedLoopJoin";
+            pairs = nested_loop_join(left, right, step.predicates);
+        }
+        else if(step.band.has_value()){
+            const BandJoin& band = step.band.value();
+            Cell::DataType type = get_type(band.value);
+
+            bool value_left = group[band.value.table] == step.left;
+
+            const Group& values = value_left ? left : right;
+            const Group& bounds = value_left ? right : left;
+
+            if(auto index_pairs = index_band_join(values, bounds, band)){
+                algorithm = "IndexBandJoin";
+                pairs = std::move(index_pairs.value());
+            }
+            else{
+                algorithm = "BandJoin";
+                pairs = band_join_pairs(get_keys(values, {band.value}, {type}),
+                    get_keys(bounds, {band.lower, band.upper}, {type, type}));
+            }
+
+            if(!value_left){
+                for(auto& [value_row, bounds_row] : pairs){
+                    std::swap(value_row, bounds_row);
+                }
+            }
+        }
+        else{
+            std::vector<ColumnReference> left_columns;
+            std::vector<ColumnReference> right_columns;
+            std::vector<Cell::DataType> types;
+
+            for(const auto& join : step.keys){
+                bool in_order = group[join.left.table] == step.left;
+
+                left_columns.push_back(in_order ? join.left : join.right);
+                right_columns.push_back(in_order ? join.right : join.left);
+                types.push_back(Cell::get_common_type(get_type(join.left), get_type(join.right)));
+            }
+
+            pairs = join_on_keys(left, right, left_columns, right_columns, types, algorithm);
+        }
+
+        left = combine_groups(left, right, pairs);
+
+        OperatorStatistics statistics;
+        statistics.add_time(start);
+        statistics.rows = left.row_count();
+        statistics.memory = estimate_join_bytes(pairs.size(), left.row_ids.size());
+
+        step_algorithms.push_back(std::move(algorithm));
+        step_statistics.push_back(statistics);
+
+        groups.erase(step.right);
+        std::ranges::replace(group, step.right, step.left);
+    }
+
+    // groups not connected by any join, the map keeps them in the FROM order of their first tables
+    auto iterator = groups.begin();
+    Group combined = std::move(iterator->second);
+
+    auto start = std::chrono::steady_clock::now();
+
+    for(++iterator; iterator != groups.end(); ++iterator){
+        const Group& other = iterator->second;
+
+        JoinPairs pairs;
+        pairs.reserve(combined.row_count() * other.row_count());
+
+        for(size_t i = 0; i < combined.row_count(); ++i){
+            for(size_t j = 0; j < other.row_count(); ++j){
+                pairs.emplace_back(i, j);
+            }
+        }
+
+        combined = combine_groups(combined, other, pairs);
+
+        cross_product_statistics.rows = combined.row_count();
+        cross_product_statistics.memory = std::max(cross_product_statistics.memory,
+            estimate_join_bytes(pairs.size(), combined.row_ids.size()));
+    }
+
+    cross_product_statistics.add_time(start);
+
+    // the rows are put together in the FROM order a batch at a time
+    std::vector<size_t> positions(tables.size());
+    for(size_t i = 0; i < combined.members.size(); ++i){
+        positions[combined.members[i]] = i;
+    }
+
+    std::vector<const Table*> ordered_inputs;
+    for(const auto& input : inputs){
+        ordered_inputs.push_back(&input);
+    }
+
+    produce_batches(combined.row_count(), [&](size_t first_row, size_t row_count){
+        std::vector<size_t> row_ids;
+        row_ids.reserve(row_count * tables.size());
+
+        for(size_t row = first_row; row < first_row + row_count; ++row){
+            for(size_t position : positions){
+                row_ids.push_back(combined.row_ids[row * tables.size() + position]);
+            }
+        }
+
+        return Table::combine_rows(ordered_inputs, row_ids);
+    }, consumer);
+}
+
+PlanNode JoinPlanner::get_plan() const {
+    std::vector<PlanNode> scans;
+
+    for(size_t i = 0; i < tables.size(); ++i){
+        PlanNode scan{"Scan", tables[i].second, {}, scan_statistics[i]};
+
+        if(reduces_rows && !filter_conditions[i].empty()){
+            scan = PlanNode{"Filter", filter_conditions[i], {std::move(scan)}, filter_statistics[i]};
+        }
+
+        scans.push_back(std::move(scan));
+    }
+
+    if(!reduces_rows){
+        if(scans.size() == 1){
+            scans.front().statistics = materialize_statistics;
+            return std::move(scans.front());
+        }
+
+        return PlanNode{"CrossProduct", "", std::move(scans), materialize_statistics};
+    }
+
+    // plan of each group of joined tables, identified as in the steps
+    std::map<size_t, PlanNode> groups;
+
+    for(size_t i = 0; i < tables.size(); ++i){
+        groups.emplace(i, std::move(scans[i]));
+    }
+
+    for(size_t k = 0; k < steps.size(); ++k){
+        const Step& step = steps[k];
+
+        PlanNode join;
+
+        if(k < step_algorithms.size()){
+            join.name = step_algorithms[k];
+            join.statistics = step_statistics[k];
+        }
+        else if(!step.predicates.empty()){
+            join.name = "NestedLoopJoin";
+        }
+        else if(step.band.has_value()){
+            join.name = "BandJoin";
+        }
+        else{
+            join.name = "EquiJoin";
+        }
+
+        join.details = std::format("{} (estimated {:.0f} rows)", step.description, estimate_rows(step.members));
+        join.children.push_back(std::move(groups.at(step.left)));
+        join.children.push_back(std::move(groups.at(step.right)));
+
+        groups.erase(step.right);
+        groups.at(step.left) = std::move(join);
+    }
+
+    PlanNode combined;
+
+    if(groups.size() == 1){
+        combined = std::move(groups.begin()->second);
+    }
+    else{
+        combined = PlanNode{"CrossProduct", "", {}, cross_product_statistics};
+
+        for(auto& [id, node] : groups){
+            combined.children.push_back(std::move(node));
+        }
+    }
+
+    return PlanNode{"Materialize", "", {std::move(combined)}, materialize_statistics};
+}
+
+std::string JoinPlanner::get_residual_condition() const {
+    if(!reduces_rows){
+        return tokens_to_string(condition);
+    }
+
+    return join_conjuncts(residual);
+}
@@ -0,0 +1,290 @@
+#include "db/join_algorithms.h"
+#include "csv/csv.h"
+#include "helper/row_container.h"
+
+#include <algorithm>
+#include <atomic>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+
+/**
+ * @brief Mixed into the hash of a key when choosing its partition
+ * @details Keeps the partitions from being correlated with the buckets of the hash tables built over them
+ */
+static constexpr size_t partition_salt = 0x9e3779b97f4a7c15;
+
+static bool key_less(const TableRow& left, const TableRow& right){
+    return std::ranges::lexicographical_compare(left, right);
+}
+
+/**
+ * @brief Get the present keys ordered by the key
+ * @return Pairs (key, row index)
+ */
+static std::vector<std::pair<TableRow, size_t>> get_sorted_keys(const JoinKeys& keys){
+    std::vector<std::pair<TableRow, size_t>> result;
+    result.reserve(keys.size());
+
+    for(size_t i = 0; i < keys.size(); ++i){
+        if(keys[i].has_value()){
+            result.emplace_back(keys[i].value(), i);
+        }
+    }
+
+    auto by_key = [](const auto& left, const auto& right){
+        return key_less(left.first, right.first);
+    };
+
+    if(!std::ranges::is_sorted(result, by_key)){
+        std::ranges::stable_sort(result, by_key);
+    }
+
+    return result;
+}
+
+JoinPairs hash_join_pairs(const JoinKeys& left, const JoinKeys& right){
+    bool build_left = left.size() <= right.size();
+
+    const JoinKeys& build = build_left ? left : right;
+    const JoinKeys& probe = build_left ? right : left;
+
+    std::unordered_map<TableRow, std::vector<size_t>, TableRowHash, TableRowIdentical> buckets;
+
+    for(size_t i = 0; i < build.size(); ++i){
+        if(build[i].has_value()){
+            buckets[build[i].value()].push_back(i);
+        }
+    }
+
+    JoinPairs result;
+
+    for(size_t i = 0; i < probe.size(); ++i){
+        if(!probe[i].has_value()){
+            continue;
+        }
+
+        auto bucket = buckets.find(probe[i].value());
+
+        if(bucket == buckets.end()){
+            continue;
+        }
+
+        for(size_t build_index : bucket->second){
+            result.push_back(build_left ? std::pair{build_index, i} : std::pair{i, build_index});
+        }
+    }
+
+    return result;
+}
+
+JoinPairs merge_join_pairs(const JoinKeys& left, const JoinKeys& right){
+    auto left_keys = get_sorted_keys(left);
+    auto right_keys = get_sorted_keys(right);
+
+    JoinPairs result;
+
+    size_t left_index = 0;
+    size_t right_index = 0;
+
+    while(left_index < left_keys.size() && right_index < right_keys.size()){
+        const TableRow& left_key = left_keys[left_index].first;
+        const TableRow& right_key = right_keys[right_index].first;
+
+        if(key_less(left_key, right_key)){
+            left_index++;
+            continue;
+        }
+        if(key_less(right_key, left_key)){
+            right_index++;
+            continue;
+        }
+
+        // every pair of the runs with the equal key matches
+        size_t left_end = left_index;
+        while(left_end < left_keys.size() && !key_less(left_key, left_keys[left_end].first)){
+            left_end++;
+        }
+
+        size_t right_end = right_index;
+        while(right_end < right_keys.size() && !key_less(right_key, right_keys[right_end].first)){
+            right_end++;
+        }
+
+        for(size_t i = left_index; i < left_end; ++i){
+            for(size_t j = right_index; j < right_end; ++j){
+                result.emplace_back(left_keys[i].second, right_keys[j].second);
+            }
+        }
+
+        left_index = left_end;
+        right_index = right_end;
+    }
+
+    return result;
+}
+
+JoinPairs band_join_pairs(const JoinKeys& values, const JoinKeys& bounds){
+    auto sorted_values = get_sorted_keys(values);
+
+    JoinPairs result;
+
+    for(size_t i = 0; i < bounds.size(); ++i){
+        if(!bounds[i].has_value()){
+            continue;
+        }
+
+        const Cell& lower = bounds[i].value()[0];
+        const Cell& upper = bounds[i].value()[1];
+
+        if(upper < lower){
+            continue;
+        }
+
+        auto begin = std::ranges::lower_bound(sorted_values, TableRow{lower}, key_less,
+            &std::pair<TableRow, size_t>::first);
+        auto end = std::ranges::upper_bound(sorted_values, TableRow{upper}, key_less,
+            &std::pair<TableRow, size_t>::first);
+
+        for(auto iterator = begin; iterator < end; ++iterator){
+            result.emplace_back(iterator->second, i);
+        }
+    }
+
+    return result;
+}
+
+std::filesystem::path get_spill_path(std::filesystem::path directory){
+    if(directory.empty()){
+        directory = std::filesystem::temp_directory_path();
+    }
+
+    static std::atomic<size_t> counter = 0;
+    static const size_t process_token = std::random_device()();
+
+    return directory / ("simpledb_spill_" + std::to_string(process_token) + "_" + std::to_string(counter++));
+}
+
+KeyPartitions::KeyPartitions(size_t partition_count, std::vector<Cell::DataType> types, std::filesystem::path directory) :
+        types(std::move(types)) {
+    for(size_t i = 0; i < partition_count; ++i){
+        paths.push_back(get_spill_path(directory));
+        files.emplace_back(paths.back(), std::ios::trunc);
+
+        if(!files.back()){
+            throw std::runtime_error("Failed to create a temporary file " + paths.back().string());
+        }
+    }
+}
+
+KeyPartitions::~KeyPartitions(){
+    files.clear();
+
+    for(const auto& path : paths){
+        std::error_code error;
+        std::filesystem::remove(path, error);
+    }
+}
+
+void KeyPartitions::add(size_t row, const std::optional<TableRow>& key){
+    if(!key.has_value()){
+        return;
+    }
+
+    size_t partition = hash_combine(TableRowHash()(key.value()), partition_salt) % paths.size();
+
+    VoidableRow line = {std::to_string(row)};
+
+    for(const auto& cell : key.value()){
+        line.push_back(cell.repr());
+    }
+
+    write_csv(files[partition], {line});
+}
+
+std::vector<std::pair<TableRow, size_t>> KeyPartitions::read(size_t partition){
+    if(!files.empty()){
+        for(auto& file : files){
+            file.close();
+
+            if(!file){
+                throw std::runtime_error("Failed to write a temporary file");
+            }
+        }
+        files.clear();
+    }
+
+    std::ifstream file(paths[partition]);
+
+    if(!file){
+        throw std::runtime_error("Failed to read a temporary file " + paths[partition].string());
+    }
+
+    std::vector<std::pair<TableRow, size_t>> result;
+
+    for(const auto& line : read_csv(file)){
+        TableRow key;
+        key.reserve(types.size());
+
+        for(size_t i = 0; i < types.size(); ++i){
+            key.emplace_back(line[i + 1].value(), types[i]);
+        }
+
+        result.emplace_back(std::move(key), std::stoull(line[0].value()));
+    }
+
+    return result;
+}
+
+JoinPairs grace_hash_join_pairs(KeyPartitions& left, KeyPartitions& right){
+    JoinPairs result;
+
+    for(size_t partition = 0; partition < left.partition_count(); ++partition){
+        auto left_keys = left.read(partition);
+        auto right_keys = right.read(partition);
+
+        bool build_left = left_keys.size() <= right_keys.size();
+
+        const auto& build = build_left ? left_keys : right_keys;
+        const auto& probe = build_left ? right_keys : left_keys;
+
+        std::unordered_map<TableRow, std::vector<size_t>, TableRowHash, TableRowIdentical> buckets;
+
+        for(const auto& [key, row] : build){
+            buckets[key].push_back(row);
+        }
+
+        for(const auto& [key, row] : probe){
+            auto bucket = buckets.find(key);
+
+            if(bucket == buckets.end()){
+                continue;
+            }
+
+            for(size_t build_row : bucket->second){
+                result.push_back(build_left ? std::pair{build_row, row} : std::pair{row, build_row});
+            }
+        }
+    }
+
+    return result;
+}
+
+bool keys_sorted(const JoinKeys& keys){
+    const TableRow* previous = nullptr;
+
+    for(const auto& key : keys){
+        if(!key.has_value()){
+            continue;
+        }
+
+        if(previous != nullptr && key_less(key.value(), *previous)){
+            return false;
+        }
+
+        previous = &key.value();
+    }
+
+    return true;
+}
@@ -0,0 +1,103 @@
+#include "db/query_plan.h"
+
+#include <algorithm>
+#include <format>
+#include <functional>
+#include <map>
+
+void OperatorStatistics::add_time(std::chrono::steady_clock::time_point start){
+    milliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void OperatorStatistics::set_output(const Table& table){
+    rows = table.get_rows().size();
+    memory = std::max(memory, estimate_table_bytes(table));
+}
+
+SubqueryProfiler::SubqueryProfiler(SelectCallback& inner) : inner(inner) {
+    callback = [this](TokenStream& stream, const VariableList& variables, SelectMode mode){
+        auto start = std::chrono::steady_clock::now();
+        Table result = this->inner(stream, variables, mode);
+        auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+
+        executions++;
+        rows += result.get_rows().size();
+        nanoseconds += elapsed.count();
+
+        size_t bytes = estimate_table_bytes(result);
+        size_t peak = memory.load();
+        while(peak < bytes && !memory.compare_exchange_weak(peak, bytes)){}
+
+        return result;
+    };
+}
+
+void SubqueryProfiler::take(SubqueryStatistics& target){
+    target.executions += executions.exchange(0);
+    target.statistics.rows = target.statistics.rows.value_or(0) + rows.exchange(0);
+    target.statistics.milliseconds += nanoseconds.exchange(0) / 1e6;
+    target.statistics.memory = std::max(target.statistics.memory, memory.exchange(0));
+}
+
+void OperatorStatistics::add_batch(const Table& batch){
+    rows = rows.value_or(0) + batch.get_rows().size();
+    memory = std::max(memory, estimate_table_bytes(batch));
+}
+
+void OperatorStatistics::add(const OperatorStatistics& other){
+    if(other.rows.has_value()){
+        rows = rows.value_or(0) + other.rows.value();
+    }
+    milliseconds += other.milliseconds;
+    memory = std::max(memory, other.memory);
+}
+
+size_t estimate_table_bytes(const Table& table){
+    size_t row_bytes = sizeof(TableRow) + table.get_header().column_count() * sizeof(Cell);
+
+    return table.get_rows().size() * row_bytes;
+}
+
+Table plan_to_table(const PlanNode& root, bool analyzed){
+    Table result({
+        {Cell::DataType::Int, "id"},
+        {Cell::DataType::Int, "parent"},
+        {Cell::DataType::String, "operator"},
+        {Cell::DataType::String, "details"},
+        {Cell::DataType::Int, "rows"},
+        {Cell::DataType::Float, "time_ms"},
+        {Cell::DataType::Int, "memory_kb"}
+    });
+
+    size_t next_id = 0;
+
+    std::function<void(const PlanNode&, std::optional<size_t>)> add_node = [&](const PlanNode& node, std::optional<size_t> parent){
+        size_t id = next_id++;
+
+        std::map<std::string, std::string> values = {
+            {"id", std::to_string(id)},
+            {"operator", node.name},
+            {"details", node.details}
+        };
+
+        if(parent.has_value()){
+            values["parent"] = std::to_string(parent.value());
+        }
+
+        if(analyzed && node.statistics.rows.has_value()){
+            values["rows"] = std::to_string(node.statistics.rows.value());
+            values["time_ms"] = std::format("{:.3f}", node.statistics.milliseconds);
+            values["memory_kb"] = std::to_string((node.statistics.memory + 1023) / 1024);
+        }
+
+        result.add_row(values);
+
+        for(const auto& child : node.children){
+            add_node(child, id);
+        }
+    };
+
+    add_node(root, std::nullopt);
+
+    return result;
+}
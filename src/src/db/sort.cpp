@@ -0,0 +1,215 @@
+#include "db/sort.h"
+#include "db/join_algorithms.h"
+#include "csv/csv.h"
+
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+ExternalSort::Run::Run(const std::filesystem::path& directory) :
+        path(get_spill_path(directory)), output(path, std::ios::trunc){
+    if(!output){
+        throw std::runtime_error("Failed to create a temporary file " + path.string());
+    }
+}
+
+ExternalSort::Run::~Run(){
+    output.close();
+    input.close();
+
+    std::error_code error;
+    std::filesystem::remove(path, error);
+}
+
+void ExternalSort::Run::write(const TableRow& row){
+    VoidableRow line;
+    line.reserve(row.size() * 2);
+
+    for(const auto& cell : row){
+        line.push_back(std::to_string((int)cell.type()));
+        line.push_back(cell.repr());
+    }
+
+    write_csv(output, {line});
+}
+
+std::optional<TableRow> ExternalSort::Run::read(){
+    if(output.is_open()){
+        output.close();
+
+        if(!output){
+            throw std::runtime_error("Failed to write a temporary file");
+        }
+
+        input.open(path);
+
+        if(!input){
+            throw std::runtime_error("Failed to read a temporary file " + path.string());
+        }
+    }
+
+    std::string line;
+    if(!std::getline(input, line)){
+        return std::nullopt;
+    }
+
+    VoidableRow cells = parse_csv_line(line);
+
+    TableRow row;
+    row.reserve(cells.size() / 2);
+
+    for(size_t i = 0; i + 1 < cells.size(); i += 2){
+        auto type = (Cell::DataType)std::stoi(cells[i].value());
+        row.push_back(cells[i + 1].has_value() ? Cell(cells[i + 1].value(), type) : Cell());
+    }
+
+    return row;
+}
+
+ExternalSort::ExternalSort(TableHeader header, std::vector<SortKey> keys, const ExecutionSettings& settings) :
+        header(std::move(header)), keys(std::move(keys)), settings(settings){
+}
+
+size_t ExternalSort::estimate_row_bytes(const TableRow& row){
+    return sizeof(TableRow) + row.size() * sizeof(Cell);
+}
+
+bool ExternalSort::precedes(const TableRow& left, const TableRow& right) const {
+    for(const auto& key : keys){
+        const Cell& left_cell = left[key.column];
+        const Cell& right_cell = right[key.column];
+
+        bool left_null = left_cell.type() == Cell::DataType::Null;
+        bool right_null = right_cell.type() == Cell::DataType::Null;
+
+        if(left_null || right_null){
+            if(left_null == right_null){
+                continue;
+            }
+            return left_null == key.nulls_first;
+        }
+
+        if(left_cell < right_cell){
+            return !key.descending;
+        }
+        if(right_cell < left_cell){
+            return key.descending;
+        }
+    }
+
+    return false;
+}
+
+void ExternalSort::add(Table batch){
+    for(const auto& row : batch.get_rows()){
+        memory += estimate_row_bytes(row);
+        rows.push_back(row);
+    }
+
+    if(memory > settings.memory_budget){
+        spill();
+    }
+}
+
+void ExternalSort::spill(){
+    std::ranges::stable_sort(rows, [this](const TableRow& left, const TableRow& right){
+        return precedes(left, right);
+    });
+
+    auto run = std::make_unique<Run>(settings.spill_directory);
+
+    for(const auto& row : rows){
+        run->write(row);
+    }
+
+    runs.push_back(std::move(run));
+    ++run_count;
+
+    rows = {};
+    memory = 0;
+}
+
+void ExternalSort::merge(std::vector<std::unique_ptr<Run>> inputs, const std::function<void(TableRow&&)>& output) const {
+    // the next row of each run as pairs (row, run index), the row going first is at the top of the heap
+    using Entry = std::pair<TableRow, size_t>;
+
+    auto goes_after = [this](const Entry& left, const Entry& right){
+        if(precedes(right.first, left.first)){
+            return true;
+        }
+        if(precedes(left.first, right.first)){
+            return false;
+        }
+        return left.second > right.second;
+    };
+
+    std::vector<Entry> heap;
+    heap.reserve(inputs.size());
+
+    for(size_t i = 0; i < inputs.size(); ++i){
+        if(auto row = inputs[i]->read()){
+            heap.emplace_back(std::move(row.value()), i);
+        }
+    }
+
+    std::ranges::make_heap(heap, goes_after);
+
+    while(!heap.empty()){
+        std::ranges::pop_heap(heap, goes_after);
+
+        size_t run = heap.back().second;
+        output(std::move(heap.back().first));
+        heap.pop_back();
+
+        if(auto row = inputs[run]->read()){
+            heap.emplace_back(std::move(row.value()), run);
+            std::ranges::push_heap(heap, goes_after);
+        }
+    }
+}
+
+Table ExternalSort::finish(){
+    if(runs.empty()){
+        std::ranges::stable_sort(rows, [this](const TableRow& left, const TableRow& right){
+            return precedes(left, right);
+        });
+
+        memory = 0;
+        return Table(header, std::exchange(rows, {}));
+    }
+
+    if(!rows.empty()){
+        spill();
+    }
+
+    // consecutive runs are merged into longer ones until they can all be merged at once
+    while(runs.size() > merge_fan_in){
+        std::vector<std::unique_ptr<Run>> merged;
+
+        for(size_t first = 0; first < runs.size(); first += merge_fan_in){
+            size_t last = std::min(first + merge_fan_in, runs.size());
+
+            std::vector<std::unique_ptr<Run>> inputs(std::make_move_iterator(runs.begin() + first),
+                std::make_move_iterator(runs.begin() + last));
+
+            auto run = std::make_unique<Run>(settings.spill_directory);
+            merge(std::move(inputs), [&run](TableRow&& row){
+                run->write(row);
+            });
+
+            merged.push_back(std::move(run));
+            ++run_count;
+        }
+
+        runs = std::move(merged);
+    }
+
+    std::vector<TableRow> sorted;
+    merge(std::exchange(runs, {}), [&sorted](TableRow&& row){
+        sorted.push_back(std::move(row));
+    });
+
+    return Table(header, std::move(sorted));
+}
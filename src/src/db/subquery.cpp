@@ -0,0 +1,369 @@
+#include "db/subquery.h"
+#include "db/cell_set.h"
+#include "db/exceptions.h"
+#include "helper/row_container.h"
+#include "jobs/worker_pool.h"
+
+#include <algorithm>
+#include <numeric>
+#include <unordered_map>
+#include <unordered_set>
+
+/**
+ * @brief Number of outer rows evaluated by a single task of the worker pool
+ */
+static constexpr size_t rows_per_task = 4;
+
+Subquery::Subquery(std::string statement, const Table& table, const VariableList& variables,
+    SelectCallback& select_callback, SubqueryCaches* caches) :
+        statement(std::move(statement)), table(table), variables(variables), select_callback(select_callback),
+        caches(caches) {}
+
+Table Subquery::evaluate_row(const TableRow& row, SelectMode mode, ReadLog* log) const {
+    BoundRow bound(table.get_header(), row, log);
+
+    TokenStream stream(statement + ";");
+
+    return select_callback(stream, variables + bound, mode);
+}
+
+SubqueryResults Subquery::evaluate(SelectMode mode) const {
+    if(caches != nullptr){
+        SubqueryCache* cache = nullptr;
+
+        {
+            auto lock = std::lock_guard(caches->mutex);
+            cache = &caches->results.try_emplace({statement, mode}).first->second;
+        }
+
+        return evaluate(*cache, mode);
+    }
+
+    SubqueryCache cache;
+
+    return evaluate(cache, mode);
+}
+
+SubqueryResults Subquery::evaluate(SubqueryCache& cache, SelectMode mode) const {
+    const auto& rows = table.get_rows();
+
+    SubqueryResults result;
+    result.tables.resize(rows.size());
+
+    auto evaluate_rows = [&](size_t begin, size_t end){
+        for(size_t i = begin; i < end; ++i){
+            auto row_result = cache.find(rows[i]);
+
+            if(row_result == nullptr){
+                ReadLog log(table.get_header().column_count());
+                row_result = std::make_shared<const Table>(evaluate_row(rows[i], mode, &log));
+
+                cache.insert(rows[i], log.get_read_columns(), row_result);
+            }
+
+            result.tables[i] = std::move(row_result);
+        }
+    };
+
+    if(rows.empty()){
+        return result;
+    }
+
+    // the first row goes alone, if the subquery is uncorrelated the others just take the cached result
+    evaluate_rows(0, 1);
+
+    WorkerPool::get_shared().parallel_for(rows.size() - 1, rows_per_task, [&](size_t begin, size_t end){
+        evaluate_rows(begin + 1, end + 1);
+    });
+
+    result.shared = std::ranges::all_of(result.tables, [&](const auto& row_result){
+        return row_result == result.tables.front();
+    });
+
+    return result;
+}
+
+bool Subquery::resolves_in_outer(const std::string& name) const {
+    try{
+        return table.get_header().get_column_info(name).has_value();
+    }
+    catch(InvalidQuery&){
+        // ambiguous
+        return true;
+    }
+}
+
+bool Subquery::is_outer_column(const std::string& name, const std::vector<TableReference>& inner_tables) const {
+    size_t dot = name.find('.');
+
+    if(dot == std::string::npos){
+        // unqualified names may be shadowed by the inner tables
+        return false;
+    }
+
+    std::string qualifier = name.substr(0, dot);
+
+    bool is_inner_alias = std::ranges::any_of(inner_tables, [&](const TableReference& reference){
+        return reference.alias == qualifier;
+    });
+
+    if(is_inner_alias){
+        return false;
+    }
+
+    try{
+        return table.get_header().get_column_info(name).has_value() && !variables.contains(name);
+    }
+    catch(InvalidQuery&){
+        return false;
+    }
+}
+
+std::optional<Subquery::Correlation> Subquery::get_correlation(const std::vector<Token>& condition,
+        const std::vector<TableReference>& inner_tables) const {
+    auto equals = std::ranges::find_if(condition, [](const Token& token){
+        return token.like("=");
+    });
+
+    if(equals == condition.end()){
+        return std::nullopt;
+    }
+
+    std::string left = tokens_to_column_name({condition.begin(), equals});
+    std::string right = tokens_to_column_name({equals + 1, condition.end()});
+
+    if(left.empty() || right.empty()){
+        return std::nullopt;
+    }
+
+    for(auto [outer, inner] : {std::pair(left, right), std::pair(right, left)}){
+        if(is_outer_column(outer, inner_tables) && !resolves_in_outer(inner)){
+            return Correlation{table.get_header().get_column_info(outer).value(), inner};
+        }
+    }
+
+    return std::nullopt;
+}
+
+std::optional<Subquery::Decorrelated> Subquery::decorrelate(bool keep_projection) const {
+    SelectClauses clauses;
+
+    try{
+        TokenStream stream(statement);
+        clauses = read_select_clauses(stream);
+    }
+    catch(InvalidQuery&){
+        return std::nullopt;
+    }
+
+    if(!clauses.group_by.empty() || has_aggregate(clauses.projection)){
+        // aggregates produce rows even for an empty input
+        return std::nullopt;
+    }
+
+    if(keep_projection && (clauses.projection.size() != 1 || clauses.projection[0].ends_with("*"))){
+        return std::nullopt;
+    }
+
+    std::vector<Correlation> correlations;
+    std::vector<std::string> residual;
+
+    for(const auto& conjunct : split_conjuncts(clauses.where)){
+        auto correlation = get_correlation(conjunct, clauses.tables);
+
+        if(correlation.has_value()){
+            correlations.push_back(std::move(correlation.value()));
+        }
+        else{
+            residual.push_back("( " + tokens_to_string(conjunct) + " )");
+        }
+    }
+
+    if(correlations.empty()){
+        return std::nullopt;
+    }
+
+    std::string rewritten = "SELECT ";
+
+    if(keep_projection){
+        rewritten += clauses.projection[0] + " , ";
+    }
+
+    for(size_t i = 0; i < correlations.size(); ++i){
+        rewritten += (i == 0 ? "" : " , ") + correlations[i].inner_column;
+    }
+
+    rewritten += " FROM ";
+
+    for(size_t i = 0; i < clauses.tables.size(); ++i){
+        rewritten += (i == 0 ? "" : " , ") + clauses.tables[i].name + " " + clauses.tables[i].alias;
+    }
+
+    for(size_t i = 0; i < residual.size(); ++i){
+        rewritten += (i == 0 ? " WHERE " : " AND ") + residual[i];
+    }
+
+    rewritten += " ;";
+
+    // the outer row is bound to NULLs, any read of it means a dependency we can't handle
+    ReadLog log(table.get_header().column_count());
+    TableRow dummy_row(table.get_header().column_count());
+    BoundRow outer_row(table.get_header(), dummy_row, &log);
+
+    try{
+        TokenStream stream(rewritten);
+        Table result = select_callback(stream, variables + outer_row, SelectMode::Full);
+
+        if(!log.empty()){
+            return std::nullopt;
+        }
+
+        return Decorrelated{std::move(correlations), std::move(result)};
+    }
+    catch(InvalidQuery&){
+        // let the row by row evaluation report the error
+        return std::nullopt;
+    }
+}
+
+std::shared_ptr<const Subquery::Decorrelated> Subquery::get_decorrelated(bool keep_projection) const {
+    auto key = std::make_pair(statement, keep_projection);
+
+    if(caches != nullptr){
+        auto lock = std::lock_guard(caches->mutex);
+
+        if(auto found = caches->decorrelated.find(key); found != caches->decorrelated.end()){
+            return found->second;
+        }
+    }
+
+    std::shared_ptr<const Decorrelated> result;
+
+    if(auto decorrelated = decorrelate(keep_projection)){
+        result = std::make_shared<const Decorrelated>(std::move(decorrelated.value()));
+    }
+
+    if(caches != nullptr){
+        // another thread may have been faster, both results are the same
+        auto lock = std::lock_guard(caches->mutex);
+        caches->decorrelated.emplace(key, result);
+    }
+
+    return result;
+}
+
+/**
+ * @brief Get the key types and positions of a decorrelated subquery result
+ * @param first_key Index of the first key column in the result
+ */
+static std::pair<std::vector<size_t>, std::vector<Cell::DataType>> get_key_columns(
+        const std::vector<ColumnDescriptor>& outer_columns, const std::vector<ColumnDescriptor>& result_columns,
+        size_t first_key){
+    std::vector<size_t> positions(outer_columns.size());
+    std::vector<Cell::DataType> types(outer_columns.size());
+
+    std::iota(positions.begin(), positions.end(), first_key);
+
+    for(size_t i = 0; i < outer_columns.size(); ++i){
+        // both sides are converted to the type used when comparing them
+        types[i] = Cell::get_common_type(outer_columns[i].type, result_columns[first_key + i].type);
+    }
+
+    return {std::move(positions), std::move(types)};
+}
+
+std::optional<BoolVector> Subquery::evaluate_exists() const {
+    auto decorrelated = get_decorrelated(false);
+
+    if(decorrelated == nullptr){
+        return std::nullopt;
+    }
+
+    const auto& [correlations, inner] = *decorrelated;
+
+    std::vector<ColumnDescriptor> outer_columns;
+    std::vector<size_t> outer_positions;
+
+    for(const auto& correlation : correlations){
+        outer_columns.push_back(correlation.outer_column);
+        outer_positions.push_back(correlation.outer_column.index);
+    }
+
+    auto [inner_positions, types] = get_key_columns(outer_columns, inner.get_columns(), 0);
+
+    std::unordered_set<TableRow, TableRowHash, TableRowIdentical> keys;
+
+    for(const auto& row : inner.get_rows()){
+        auto key = make_typed_key(row, inner_positions, types);
+
+        if(key.has_value()){
+            keys.insert(std::move(key.value()));
+        }
+    }
+
+    const auto& rows = table.get_rows();
+    BoolVector result(rows.size());
+
+    for(size_t i = 0; i < rows.size(); ++i){
+        auto key = make_typed_key(rows[i], outer_positions, types);
+
+        result[i] = key.has_value() && keys.contains(key.value());
+    }
+
+    return result;
+}
+
+std::optional<BoolVector> Subquery::evaluate_in(const CellVector& values) const {
+    auto decorrelated = get_decorrelated(true);
+
+    if(decorrelated == nullptr){
+        return std::nullopt;
+    }
+
+    const auto& [correlations, inner] = *decorrelated;
+
+    std::vector<ColumnDescriptor> outer_columns;
+    std::vector<size_t> outer_positions;
+
+    for(const auto& correlation : correlations){
+        outer_columns.push_back(correlation.outer_column);
+        outer_positions.push_back(correlation.outer_column.index);
+    }
+
+    // the searched values are in the first column
+    auto [inner_positions, types] = get_key_columns(outer_columns, inner.get_columns(), 1);
+
+    std::unordered_map<TableRow, std::vector<Cell>, TableRowHash, TableRowIdentical> groups;
+
+    for(const auto& row : inner.get_rows()){
+        auto key = make_typed_key(row, inner_positions, types);
+
+        if(key.has_value()){
+            groups[std::move(key.value())].push_back(row[0]);
+        }
+    }
+
+    std::unordered_map<TableRow, CellSet, TableRowHash, TableRowIdentical> searched_values;
+
+    for(auto&& [key, group] : groups){
+        searched_values.emplace(key, CellSet(std::move(group)));
+    }
+
+    const auto& rows = table.get_rows();
+    BoolVector result(rows.size());
+
+    for(size_t i = 0; i < rows.size(); ++i){
+        auto key = make_typed_key(rows[i], outer_positions, types);
+
+        if(!key.has_value()){
+            result[i] = false;
+            continue;
+        }
+
+        auto iterator = searched_values.find(key.value());
+
+        result[i] = iterator != searched_values.end() && iterator->second.contains(values[i]);
+    }
+
+    return result;
+}
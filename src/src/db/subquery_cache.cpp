@@ -0,0 +1,67 @@
+#include "db/subquery_cache.h"
+
+#include <algorithm>
+
+SubqueryCache::SubqueryCache(size_t max_cells) : max_cells(max_cells) {}
+
+TableRow SubqueryCache::make_key(const TableRow& row, const std::vector<size_t>& columns){
+    TableRow key;
+    key.reserve(columns.size());
+
+    for(size_t column : columns){
+        key.push_back(row[column]);
+    }
+
+    return key;
+}
+
+std::shared_ptr<const Table> SubqueryCache::find(const TableRow& row){
+    auto lock = std::unique_lock(mutex);
+
+    for(const auto& entry : entries){
+        auto iterator = entry.results.find(make_key(row, entry.columns));
+
+        if(iterator != entry.results.end()){
+            hit_count++;
+            return iterator->second;
+        }
+    }
+
+    miss_count++;
+    return nullptr;
+}
+
+void SubqueryCache::insert(const TableRow& row, const std::vector<size_t>& read_columns, std::shared_ptr<const Table> result){
+    // the header is counted as one more row
+    size_t cells = (result->get_rows().size() + 1) * result->get_columns().size();
+
+    auto lock = std::unique_lock(mutex);
+
+    // a result not depending on the row serves all rows, so it is always kept
+    if(!read_columns.empty() && cached_cells + cells > max_cells){
+        return;
+    }
+
+    auto entry = std::ranges::find_if(entries, [&](const Entry& entry){
+        return entry.columns == read_columns;
+    });
+
+    if(entry == entries.end()){
+        entries.push_back({read_columns, {}});
+        entry = entries.end() - 1;
+    }
+
+    if(entry->results.emplace(make_key(row, read_columns), std::move(result)).second){
+        cached_cells += cells;
+    }
+}
+
+size_t SubqueryCache::hits() const {
+    auto lock = std::unique_lock(mutex);
+    return hit_count;
+}
+
+size_t SubqueryCache::misses() const {
+    auto lock = std::unique_lock(mutex);
+    return miss_count;
+}
@@ -4,12 +4,15 @@
 #include "db/exceptions.h"
 #include "db/expression.h"
 #include "db/variable_list.h"
+#include "db/table_index.h"
 #include "helper/row_container.h"
 
+#include <algorithm>
 #include <cassert>
 #include <mutex>
 #include <ranges>
 #include <functional>
+#include <limits>
 #include <unordered_set>
 
 TableHeader::TableHeader(std::vector<std::pair<Cell::DataType, std::string>> column_definitions)
@@ -29,10 +32,29 @@ TableHeader TableHeader::join(const TableHeader& left, const TableHeader& right)
     return TableHeader(left, right);
 }
 
+TableHeader TableHeader::select(const std::vector<size_t>& indexes) const {
+    TableHeader header;
+    
+    for(size_t index : indexes){
+        ColumnDescriptor column = columns[index];
+        column.index = header.columns.size();
+        header.columns.push_back(std::move(column));
+    }
+    
+    header.calculate_lookup_map();
+    
+    return header;
+}
+
 TableHeader TableHeader::add_alias(const std::string& alias) const {
     TableHeader header(*this);
     
     for(auto& column : header.columns){
+        if(column.alias == alias){
+            // already qualified by the alias
+            continue;
+        }
+        
         column.alias = alias;
         
         std::string qualified_name = alias + "." + column.name;
@@ -120,6 +142,11 @@ Table::Table(std::vector<std::pair<Cell::DataType, std::string>> columns):
 {
 }
 
+Table::Table(TableHeader header, std::vector<TableRow> rows):
+    header(std::move(header)), rows(std::move(rows))
+{
+}
+
 Table::Table(Table&& other) noexcept : 
     header(std::move(other.header)), rows(std::move(other.rows))
 {
@@ -128,12 +155,106 @@ Table::Table(Table&& other) noexcept :
 Table& Table::operator=(Table&& other) noexcept {
     header = std::move(other.header);
     rows = std::move(other.rows);
+    drop_indexes();
     
     return *this;
 }
 
 void Table::add_row(TableRow data){
     rows.push_back(std::move(data));
+    drop_indexes();
+}
+
+void Table::drop_indexes(){
+    auto lock = std::unique_lock(index_mutex);
+    indexes.clear();
+    column_statistics.clear();
+    ++version;
+}
+
+size_t Table::get_version() const {
+    auto index_lock = std::unique_lock(index_mutex);
+    
+    return version;
+}
+
+std::shared_ptr<const TableIndex> Table::get_index(IndexKind kind, const std::vector<size_t>& columns,
+        const std::vector<Cell::DataType>& types) const {
+    auto lock = std::shared_lock(mutex);
+    auto index_lock = std::unique_lock(index_mutex);
+    
+    return find_index(kind, columns, types);
+}
+
+std::shared_ptr<const TableIndex> Table::get_index(IndexKind kind, const std::vector<size_t>& columns,
+        const std::vector<Cell::DataType>& types, size_t version) const {
+    auto lock = std::shared_lock(mutex);
+    auto index_lock = std::unique_lock(index_mutex);
+    
+    if(version != this->version){
+        return nullptr;
+    }
+    
+    return find_index(kind, columns, types);
+}
+
+std::shared_ptr<const TableIndex> Table::find_index(IndexKind kind, const std::vector<size_t>& columns,
+        const std::vector<Cell::DataType>& types) const {
+    auto& index = indexes[{kind, columns, types}];
+    
+    if(index == nullptr){
+        index = std::make_shared<const TableIndex>(kind, rows, columns, types);
+    }
+    
+    return index;
+}
+
+ColumnStatistics Table::get_column_statistics(size_t column) const {
+    auto lock = std::shared_lock(mutex);
+    auto index_lock = std::unique_lock(index_mutex);
+    
+    return find_column_statistics(column);
+}
+
+std::optional<ColumnStatistics> Table::get_column_statistics(size_t column, size_t version) const {
+    auto lock = std::shared_lock(mutex);
+    auto index_lock = std::unique_lock(index_mutex);
+    
+    if(version != this->version){
+        return std::nullopt;
+    }
+    
+    return find_column_statistics(column);
+}
+
+namespace {
+struct CellIdentical{
+    bool operator()(const Cell& left, const Cell& right) const {
+        return Cell::is_identical(left, right);
+    }
+};
+}
+
+ColumnStatistics Table::find_column_statistics(size_t column) const {
+    auto cached = column_statistics.find(column);
+    
+    if(cached != column_statistics.end()){
+        return cached->second;
+    }
+    
+    std::unordered_set<Cell, std::hash<Cell>, CellIdentical> values;
+    size_t non_null = 0;
+    
+    for(const auto& row : rows){
+        if(row[column].type() != Cell::DataType::Null){
+            values.insert(row[column]);
+            non_null++;
+        }
+    }
+    
+    double non_null_fraction = rows.empty() ? 1 : static_cast<double>(non_null) / rows.size();
+    
+    return column_statistics[column] = {values.size(), non_null_fraction};
 }
 
 void Table::add_row(const std::vector<std::string>& data){
@@ -158,6 +279,22 @@ void Table::add_row(const std::map<std::string, std::string>& values){
 }
 
 Table Table::cross_product(std::vector<std::pair<const Table&, std::string>> tables){
+    return cross_product(tables, 0, std::numeric_limits<size_t>::max());
+}
+
+size_t Table::cross_product_size(const std::vector<std::pair<const Table&, std::string>>& tables){
+    size_t result = 1;
+    
+    for(auto& [table, alias] : tables){
+        auto lock = std::shared_lock(table.mutex);
+        result *= table.row_count();
+    }
+    
+    return result;
+}
+
+Table Table::cross_product(const std::vector<std::pair<const Table&, std::string>>& tables,
+        size_t first_row, size_t row_count){
     assert(!tables.empty());
     
     std::vector<std::shared_lock<std::shared_mutex>> locks;
@@ -166,25 +303,122 @@ Table Table::cross_product(std::vector<std::pair<const Table&, std::string>> tab
     }
     
     TableHeader header = tables[0].first.header.add_alias(tables[0].second);
-    std::vector<TableRow> rows = tables[0].first.rows;
     
     for(auto& [table, alias] : tables | std::views::drop(1)){
-        std::vector<TableRow> new_rows;
-        for(const auto& row1 : rows){
-            for(const auto& row2 : table.rows){
-                std::vector<Cell> combined = row1;
-                combined.append_range(row2);
-                new_rows.push_back(combined);
+        header = TableHeader::join(header, table.header.add_alias(alias));
+    }
+    
+    Table result(std::move(header));
+    
+    size_t total_rows = 1;
+    for(auto& [table, alias] : tables){
+        total_rows *= table.row_count();
+    }
+    
+    if(first_row >= total_rows){
+        return result;
+    }
+    
+    size_t last_row = first_row + std::min(row_count, total_rows - first_row);
+    
+    // position of the current row in each table, the last table changes fastest
+    std::vector<size_t> position(tables.size());
+    
+    size_t remaining = first_row;
+    for(size_t i = tables.size(); i-- > 0;){
+        position[i] = remaining % tables[i].first.row_count();
+        remaining /= tables[i].first.row_count();
+    }
+    
+    result.rows.reserve(last_row - first_row);
+    
+    for(size_t row_index = first_row; row_index < last_row; ++row_index){
+        TableRow row;
+        row.reserve(result.header.column_count());
+        
+        for(size_t i = 0; i < tables.size(); ++i){
+            row.append_range(tables[i].first.rows[position[i]]);
+        }
+        
+        result.rows.push_back(std::move(row));
+        
+        for(size_t i = tables.size(); i-- > 0;){
+            if(++position[i] < tables[i].first.row_count()){
+                break;
             }
+            position[i] = 0;
         }
-        header = TableHeader::join(header, table.header.add_alias(alias));
-        rows = std::move(new_rows);
+    }
+    
+    return result;
+}
+
+Table Table::combine_rows(const std::vector<const Table*>& tables, const std::vector<size_t>& row_ids){
+    assert(!tables.empty());
+    
+    std::vector<std::shared_lock<std::shared_mutex>> locks;
+    for(const Table* table : tables){
+        locks.emplace_back(table->mutex);
+    }
+    
+    TableHeader header = tables[0]->header;
+    
+    for(const Table* table : tables | std::views::drop(1)){
+        header = TableHeader::join(header, table->header);
     }
     
     Table result(std::move(header));
     
-    for(const auto& row : rows){
-        result.add_row(row);
+    size_t row_count = row_ids.size() / tables.size();
+    result.rows.reserve(row_count);
+    
+    for(size_t row_index = 0; row_index < row_count; ++row_index){
+        TableRow row;
+        row.reserve(result.header.column_count());
+        
+        for(size_t i = 0; i < tables.size(); ++i){
+            size_t row_id = row_ids[row_index * tables.size() + i];
+            row.append_range(tables[i]->rows[row_id]);
+        }
+        
+        result.rows.push_back(std::move(row));
+    }
+    
+    return result;
+}
+
+Table Table::select_columns(TableHeader new_header, const std::vector<size_t>& columns) const {
+    return select_columns(std::move(new_header), columns, 0, std::numeric_limits<size_t>::max());
+}
+
+Table Table::select_columns(TableHeader new_header, const std::vector<size_t>& columns, size_t first_row,
+        size_t row_count) const {
+    auto lock = std::shared_lock(mutex);
+    
+    return select_locked_columns(std::move(new_header), columns, first_row, row_count);
+}
+
+std::shared_lock<std::shared_mutex> Table::lock_rows([[maybe_unused]] Accessor accessor) const {
+    return std::shared_lock(mutex);
+}
+
+Table Table::select_locked_columns(TableHeader new_header, const std::vector<size_t>& columns, size_t first_row,
+        size_t row_count, [[maybe_unused]] Accessor accessor) const {
+    first_row = std::min(first_row, rows.size());
+    size_t last_row = first_row + std::min(row_count, rows.size() - first_row);
+    
+    Table result(std::move(new_header));
+    result.rows.reserve(last_row - first_row);
+    
+    for(const auto& row : std::ranges::subrange(rows.begin() + first_row, rows.begin() + last_row)){
+        TableRow new_row;
+        new_row.reserve(columns.size());
+        
+        for(size_t column : columns){
+            new_row.push_back(row[column]);
+        }
+        
+        result.rows.push_back(std::move(new_row));
     }
     
     return result;
@@ -200,9 +434,9 @@ const std::vector<ColumnDescriptor>& TableHeader::get_columns() const{
 
 
 void Table::filter_by_condition(TokenStream& stream, const VariableList& variables, 
-        std::function<Table(TokenStream&, const VariableList&)> select_callback, bool negate) {
+        SelectCallback select_callback, bool negate, SubqueryCaches* subquery_caches) {
             
-    auto condition_result = evaluate_condition(stream, variables, select_callback);
+    auto condition_result = evaluate_condition(stream, variables, select_callback, subquery_caches);
     
     auto lock = std::unique_lock(mutex);
     
@@ -215,51 +449,13 @@ void Table::filter_by_condition(TokenStream& stream, const VariableList& variabl
     }
     
     rows = std::move(new_rows);
-}
-
-std::vector<Table> Table::group_by(const std::vector<std::string>& grouping_columns) {
-    std::unordered_map<std::vector<Cell>, Table, TableRowHash, TableRowIdentical> mapping;
-
-    auto lock = std::unique_lock(mutex);
-    
-    std::vector<size_t> selected_column_indexes;
-    
-    for(auto&& column : grouping_columns){
-        auto descriptor = header.get_column_info(column);
-        
-        if(!descriptor.has_value()){
-            throw InvalidQuery("Grouping by non-existent column " + column);
-        }
-        
-        selected_column_indexes.push_back(descriptor->index);
-    }
-    
-    for(auto&& row : rows){
-        std::vector<Cell> selected_columns;
-        for(size_t i : selected_column_indexes){
-            selected_columns.push_back(row[i]);
-        }
-        
-        mapping.try_emplace(selected_columns, header);
-        
-        mapping.at(selected_columns).add_row(std::move(row));
-    }
-    
-    rows.clear();
-    
-    std::vector<Table> result;
-    
-    for(auto&& [groups, table] : mapping){
-        result.push_back(std::move(table));
-    }
-    
-    return result;
+    drop_indexes();
 }
 
 BoolVector Table::evaluate_condition(TokenStream& stream, const VariableList& variables, 
-        std::function<Table(TokenStream&, const VariableList&)> select_callback,[[maybe_unused]] Accessor accessor) const {
+        SelectCallback select_callback, SubqueryCaches* subquery_caches, [[maybe_unused]] Accessor accessor) const {
     
-    ConditionEvaluation evaluation(*this, stream, variables, select_callback);
+    ConditionEvaluation evaluation(*this, stream, variables, select_callback, subquery_caches);
     return  evaluation.evaluate();
 }
 
@@ -283,7 +479,7 @@ static T extract_same(const C& container){
 }
 
 bool Table::evaluate_aggregate_condition(TokenStream& stream, const VariableList& variables, 
-        std::function<Table(TokenStream&, const VariableList&)> select_callback) const {
+        SelectCallback select_callback) const {
     
     auto lock = std::shared_lock(mutex);
     
@@ -296,21 +492,36 @@ bool Table::evaluate_aggregate_condition(TokenStream& stream, const VariableList
     return extract_same<BoolVector,bool>(values);
 }
 
-void Table::deduplicate(){
+void Table::keep_rows(const BoolVector& keep){
     auto lock = std::unique_lock(mutex);
     
-    std::unordered_set<TableRow, TableRowHash, TableRowIdentical> row_set;
-    for(auto&& row : rows){
-        row_set.insert(std::move(row));
+    std::vector<TableRow> new_rows;
+    
+    for(size_t i = 0; i < rows.size(); ++i){
+        if(keep[i]){
+            new_rows.push_back(std::move(rows[i]));
+        }
     }
     
-    rows = std::vector(row_set.begin(), row_set.end());
+    rows = std::move(new_rows);
+    drop_indexes();
 }
 
 void Table::vertical_join(const Table& other){
     auto lock = std::unique_lock(mutex);
     
     rows.append_range(other.rows);
+    drop_indexes();
+}
+
+void Table::vertical_join(Table&& other){
+    auto lock = std::unique_lock(mutex);
+    auto other_lock = std::unique_lock(other.mutex);
+    
+    rows.insert(rows.end(), std::make_move_iterator(other.rows.begin()), std::make_move_iterator(other.rows.end()));
+    other.rows.clear();
+    drop_indexes();
+    other.drop_indexes();
 }
 
 Table Table::project(const std::vector<std::string>& expressions, const VariableList& variables, bool aggregate_mode) const {
@@ -370,4 +581,10 @@ Table Table::clone() const{
 void Table::clear_rows() {
     auto lock = std::unique_lock(mutex);
     rows.clear();
+    drop_indexes();
+}
+
+bool Table::empty() const {
+    auto lock = std::shared_lock(mutex);
+    return rows.empty();
 }
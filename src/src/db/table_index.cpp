@@ -0,0 +1,60 @@
+#include "db/table_index.h"
+
+#include <algorithm>
+#include <cassert>
+
+static bool key_less(const TableRow& left, const TableRow& right){
+    return std::ranges::lexicographical_compare(left, right);
+}
+
+TableIndex::TableIndex(IndexKind kind, const std::vector<TableRow>& rows, const std::vector<size_t>& columns,
+        const std::vector<Cell::DataType>& types) : kind(kind) {
+    for(size_t i = 0; i < rows.size(); ++i){
+        auto key = make_typed_key(rows[i], columns, types);
+
+        if(!key.has_value()){
+            continue;
+        }
+
+        if(kind == IndexKind::Hash){
+            buckets[std::move(key.value())].push_back(i);
+        }
+        else{
+            entries.emplace_back(std::move(key.value()), i);
+        }
+    }
+
+    std::ranges::stable_sort(entries, key_less, &std::pair<TableRow, size_t>::first);
+}
+
+void TableIndex::find_equal(const TableRow& key, std::vector<size_t>& result) const {
+    if(kind == IndexKind::Hash){
+        auto bucket = buckets.find(key);
+
+        if(bucket != buckets.end()){
+            result.append_range(bucket->second);
+        }
+        return;
+    }
+
+    auto [begin, end] = std::ranges::equal_range(entries, key, key_less, &std::pair<TableRow, size_t>::first);
+
+    for(auto iterator = begin; iterator != end; ++iterator){
+        result.push_back(iterator->second);
+    }
+}
+
+void TableIndex::find_range(const Cell& lower, const Cell& upper, std::vector<size_t>& result) const {
+    assert(kind == IndexKind::Ordered);
+
+    if(upper < lower){
+        return;
+    }
+
+    auto begin = std::ranges::lower_bound(entries, TableRow{lower}, key_less, &std::pair<TableRow, size_t>::first);
+    auto end = std::ranges::upper_bound(entries, TableRow{upper}, key_less, &std::pair<TableRow, size_t>::first);
+
+    for(auto iterator = begin; iterator < end; ++iterator){
+        result.push_back(iterator->second);
+    }
+}
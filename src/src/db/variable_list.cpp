@@ -1,8 +1,32 @@
 #include "db/variable_list.h"
 #include "db/exceptions.h"
 
-BoundRow::BoundRow(const TableHeader& header, const TableRow& row):
-    header(header), row(row) {}
+ReadLog::ReadLog(size_t column_count) : read(column_count) {}
+
+void ReadLog::record(size_t index){
+    if(!read[index].load(std::memory_order_relaxed)){
+        read[index].store(true, std::memory_order_relaxed);
+    }
+}
+
+bool ReadLog::empty() const {
+    return get_read_columns().empty();
+}
+
+std::vector<size_t> ReadLog::get_read_columns() const {
+    std::vector<size_t> result;
+    
+    for(size_t i = 0; i < read.size(); ++i){
+        if(read[i].load(std::memory_order_relaxed)){
+            result.push_back(i);
+        }
+    }
+    
+    return result;
+}
+
+BoundRow::BoundRow(const TableHeader& header, const TableRow& row, ReadLog* log):
+    header(header), row(row), log(log) {}
 
 // apparently references can't be in std::optional...
 std::optional<std::pair<const Cell*, Cell::DataType>> BoundRow::get_value(const std::string& name) const{
@@ -17,9 +41,15 @@ std::optional<std::pair<const Cell*, Cell::DataType>> BoundRow::get_value(const
     return std::make_pair(&row[index], type);
 }
 
+void BoundRow::record_read(const Cell* value) const{
+    if(log != nullptr){
+        log->record(value - row.data());
+    }
+}
+
 
-std::pair<const Cell*, Cell::DataType> VariableList::get_info(const std::string& name) const{
-    std::optional<std::pair<const Cell*, Cell::DataType>> result;
+std::tuple<const BoundRow*, const Cell*, Cell::DataType> VariableList::get_info(const std::string& name) const{
+    std::optional<std::tuple<const BoundRow*, const Cell*, Cell::DataType>> result;
     
     for(const auto& member : members){
         auto value = member.get_value(name);
@@ -32,7 +62,7 @@ std::pair<const Cell*, Cell::DataType> VariableList::get_info(const std::string&
             throw InvalidQuery("Non-unique variable name: " + name);
         }
         
-        result = value;
+        result = {&member, value->first, value->second};
     }
     
     if(!result.has_value()){
@@ -43,15 +73,26 @@ std::pair<const Cell*, Cell::DataType> VariableList::get_info(const std::string&
 }
 
 const Cell& VariableList::get_value(const std::string& name) const{
-    auto [value, type] = get_info(name);
+    auto [member, value, type] = get_info(name);
+    member->record_read(value);
     return *value;
 }
 
 Cell::DataType VariableList::get_type(const std::string& name) const{
-    auto [_, type] = get_info(name);
+    auto [member, value, type] = get_info(name);
     return type;
 }
 
+bool VariableList::contains(const std::string& name) const{
+    for(const auto& member : members){
+        if(member.get_value(name).has_value()){
+            return true;
+        }
+    }
+    
+    return false;
+}
+
 
 VariableList VariableList::operator+(BoundRow other) const{
     VariableList result(*this);
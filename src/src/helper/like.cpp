@@ -1,34 +1,170 @@
 #include "helper/like.h"
 
-#include <regex>
+#include <mutex>
+#include <unordered_map>
 
-static std::string escape(char c){
-    static const std::string special_regex_chars = "([\\^$.|?*+(){}])";
-    
-    std::string result;
-    if(std::count(special_regex_chars.begin(), special_regex_chars.end(), c)){
-        result += "\\";
+/**
+ * @brief Maximum number of patterns kept in the cache
+ */
+static constexpr size_t max_cached_patterns = 256;
+
+LikePattern::LikePattern(const std::string& pattern) :
+    anchored_start(!pattern.starts_with('%')), anchored_end(!pattern.ends_with('%'))
+{
+    bool has_wildcard_char = false;
+
+    segments.emplace_back();
+    for(char c : pattern){
+        if(c == '%'){
+            if(!segments.back().empty()){
+                segments.emplace_back();
+            }
+            continue;
+        }
+        if(c == '_'){
+            has_wildcard_char = true;
+        }
+        segments.back() += c;
+    }
+
+    if(segments.size() > 1 && segments.back().empty()){
+        segments.pop_back();
+    }
+
+    if(has_wildcard_char || segments.size() > 1){
+        kind = Kind::General;
+    }
+    else if(anchored_start && anchored_end){
+        kind = Kind::Exact;
+    }
+    else if(anchored_start){
+        kind = Kind::Prefix;
+    }
+    else if(anchored_end){
+        kind = Kind::Suffix;
+    }
+    else{
+        kind = Kind::Contains;
     }
-    result += c;
-    return result;
 }
 
-static std::string convert_to_regex(const std::string& pattern){
-    std::string result="^";
-    for(auto c : pattern){
-        if(c == '%'){
-            result += ".*";
-        }else if(c == '_'){
-            result += ".";
-        }else{
-            result += escape(c);
+bool LikePattern::matches(std::string_view value) const {
+    switch(kind){
+        case Kind::Exact:
+            return value == segments[0];
+        case Kind::Prefix:
+            return value.starts_with(segments[0]);
+        case Kind::Suffix:
+            return value.ends_with(segments[0]);
+        case Kind::Contains:
+            return value.find(segments[0]) != std::string_view::npos;
+        case Kind::General:
+            return matches_general(value);
+    }
+    return false;
+}
+
+/**
+ * @brief Check if a segment matches the value at given position
+ */
+static bool segment_matches_at(std::string_view value, size_t position, const std::string& segment){
+    if(position + segment.size() > value.size()){
+        return false;
+    }
+
+    for(size_t i = 0; i < segment.size(); ++i){
+        if(segment[i] != '_' && segment[i] != value[position + i]){
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief Find the leftmost match of a segment starting at or after position
+ * @return The position of the match or `std::string_view::npos`
+ */
+static size_t find_segment(std::string_view value, size_t position, const std::string& segment){
+    if(segment.find('_') == std::string::npos){
+        return value.find(segment, position);
+    }
+
+    for(; position + segment.size() <= value.size(); ++position){
+        if(segment_matches_at(value, position, segment)){
+            return position;
         }
     }
-    return result + "$";
+
+    return std::string_view::npos;
+}
+
+bool LikePattern::matches_general(std::string_view value) const {
+    size_t first = 0;
+    size_t last = segments.size();
+
+    size_t begin = 0;
+    size_t end = value.size();
+
+    if(anchored_start){
+        if(!segment_matches_at(value, 0, segments[first])){
+            return false;
+        }
+        begin = segments[first].size();
+        first++;
+    }
+
+    if(anchored_end && first < last){
+        const std::string& segment = segments[last - 1];
+
+        if(segment.size() > end - begin || !segment_matches_at(value, end - segment.size(), segment)){
+            return false;
+        }
+        end -= segment.size();
+        last--;
+    }
+
+    if(anchored_start && anchored_end && segments.size() == 1){
+        // no `%` at all, the single segment must cover the whole value
+        return begin == value.size();
+    }
+
+    std::string_view middle = value.substr(0, end);
+
+    for(size_t i = first; i < last; ++i){
+        size_t position = find_segment(middle, begin, segments[i]);
+
+        if(position == std::string_view::npos){
+            return false;
+        }
+
+        begin = position + segments[i].size();
+    }
+
+    return true;
+}
+
+std::shared_ptr<const LikePattern> LikePattern::get(const std::string& pattern){
+    static std::mutex mutex;
+    static std::unordered_map<std::string, std::shared_ptr<const LikePattern>> cache;
+
+    auto lock = std::unique_lock(mutex);
+
+    auto iterator = cache.find(pattern);
+    if(iterator != cache.end()){
+        return iterator->second;
+    }
+
+    if(cache.size() >= max_cached_patterns){
+        cache.clear();
+    }
+
+    auto compiled = std::make_shared<const LikePattern>(pattern);
+    cache.emplace(pattern, compiled);
+
+    return compiled;
 }
 
 bool is_like(const std::string& value, const std::string& pattern){
-    std::string regex_pattern = convert_to_regex(pattern);
-    std::regex regex(regex_pattern);
-    return std::regex_match(value, regex);
+    return LikePattern::get(pattern)->matches(value);
 }
@@ -0,0 +1,153 @@
+#include "jobs/worker_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <limits>
+
+/**
+ * @brief State of a single `parallel_for` call
+ */
+struct WorkerPool::Loop{
+    size_t count;
+    size_t chunk_size;
+    const std::function<void(size_t, size_t)>& body;
+
+    std::atomic<size_t> next_index = 0;   /**< Start of the next unclaimed range */
+
+    std::mutex mutex;
+    std::condition_variable finished;
+    size_t running = 0;                     /**< Claimed ranges not yet processed */
+
+    size_t exception_index = std::numeric_limits<size_t>::max();
+    std::exception_ptr exception;
+
+    Loop(size_t count, size_t chunk_size, const std::function<void(size_t, size_t)>& body) :
+        count(count), chunk_size(chunk_size), body(body) {}
+
+    /**
+     * @brief Claim and process a range
+     * @return False if there was no range left
+     */
+    bool run_chunk(){
+        {
+            // claiming under the lock lets the caller wait for claimed ranges only
+            auto lock = std::unique_lock(mutex);
+
+            if(next_index >= count){
+                return false;
+            }
+            running++;
+        }
+
+        size_t begin = next_index.fetch_add(chunk_size);
+
+        if(begin < count){
+            try{
+                body(begin, std::min(begin + chunk_size, count));
+            }
+            catch(...){
+                auto lock = std::unique_lock(mutex);
+
+                if(begin < exception_index){
+                    exception_index = begin;
+                    exception = std::current_exception();
+                }
+                // skip the ranges nobody started yet
+                next_index = count;
+            }
+        }
+
+        auto lock = std::unique_lock(mutex);
+        running--;
+        if(running == 0){
+            finished.notify_all();
+        }
+
+        return begin < count;
+    }
+};
+
+WorkerPool::WorkerPool(size_t thread_count){
+    for(size_t i = 0; i < thread_count; ++i){
+        threads.emplace_back([this](){
+            work();
+        });
+    }
+}
+
+WorkerPool::~WorkerPool(){
+    {
+        auto lock = std::unique_lock(mutex);
+        stopping = true;
+    }
+    work_available.notify_all();
+
+    for(auto& thread : threads){
+        thread.join();
+    }
+}
+
+WorkerPool& WorkerPool::get_shared(){
+    static WorkerPool pool(std::max(std::thread::hardware_concurrency(), 1u) - 1);
+    return pool;
+}
+
+void WorkerPool::remove_loop(const std::shared_ptr<Loop>& loop){
+    auto lock = std::unique_lock(mutex);
+    loops.remove(loop);
+}
+
+void WorkerPool::work(){
+    while(true){
+        std::shared_ptr<Loop> loop;
+
+        {
+            auto lock = std::unique_lock(mutex);
+            work_available.wait(lock, [this](){
+                return stopping || !loops.empty();
+            });
+
+            if(stopping){
+                return;
+            }
+
+            loop = loops.front();
+        }
+
+        while(loop->run_chunk()){}
+
+        remove_loop(loop);
+    }
+}
+
+void WorkerPool::parallel_for(size_t count, size_t chunk_size, const std::function<void(size_t, size_t)>& body){
+    if(count == 0){
+        return;
+    }
+
+    chunk_size = std::max<size_t>(chunk_size, 1);
+
+    auto loop = std::make_shared<Loop>(count, chunk_size, body);
+
+    if(!threads.empty() && count > chunk_size){
+        {
+            auto lock = std::unique_lock(mutex);
+            loops.push_back(loop);
+        }
+        work_available.notify_all();
+    }
+
+    while(loop->run_chunk()){}
+
+    remove_loop(loop);
+
+    auto lock = std::unique_lock(loop->mutex);
+    loop->finished.wait(lock, [&](){
+        return loop->running == 0;
+    });
+
+    if(loop->exception){
+        std::rethrow_exception(loop->exception);
+    }
+}
@@ -11,6 +11,10 @@ static const std::vector<std::string> keyword_list = {
     "GROUP",
     "BY",
     "HAVING",
+    "ORDER",
+    "ASC",
+    "DESC",
+    "NULLS",
     "INSERT",
     "INTO",
     "VALUES",
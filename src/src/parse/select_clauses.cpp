@@ -0,0 +1,334 @@
+#include "parse/select_clauses.h"
+#include "parse/keywords.h"
+#include "helper/string.h"
+#include "db/exceptions.h"
+
+#include <algorithm>
+
+/**
+ * @brief Track the bracket nesting level while iterating over tokens
+ */
+static void update_nesting(const Token& token, size_t& nesting_level){
+    if(is_word(token, "(")){
+        nesting_level++;
+    }
+    if(is_word(token, ")")){
+        if(nesting_level == 0){
+            throw InvalidQuery("Unmatched bracket");
+        }
+        nesting_level--;
+    }
+}
+
+/**
+ * @brief Check if the stream is at the end of a statement
+ */
+static bool at_statement_end(TokenStream& stream){
+    return stream.empty() || is_word(stream.peek_token(), ";");
+}
+
+static std::vector<std::string> read_projection(TokenStream& stream){
+    std::vector<std::string> projection(1);
+    size_t nesting_level = 0;
+
+    while(true){
+        if(at_statement_end(stream)){
+            throw InvalidQuery("No FROM statement found");
+        }
+
+        Token token = stream.get_token();
+
+        if(nesting_level == 0 && is_word(token, "FROM")){
+            break;
+        }
+        if(nesting_level == 0 && is_word(token, ",")){
+            projection.push_back("");
+            continue;
+        }
+
+        update_nesting(token, nesting_level);
+
+        if(!projection.back().empty()){
+            projection.back() += " ";
+        }
+        projection.back() += token.get_raw();
+    }
+
+    return projection;
+}
+
+static std::vector<TableReference> read_tables(TokenStream& stream){
+    std::vector<TableReference> tables;
+
+    while(true){
+        std::string name = stream.get_token(TokenType::Identifier);
+        std::string alias = name;
+
+        const Token& next_token = stream.peek_token();
+        if(next_token.get_type() == TokenType::Identifier && !is_keyword(next_token.get_value())){
+            alias = stream.get_token().get_value();
+        }
+
+        tables.push_back({std::move(name), std::move(alias)});
+
+        if(!stream.try_ignore_token(",")){
+            break;
+        }
+    }
+
+    return tables;
+}
+
+/**
+ * @brief Read a condition up to the end of the statement or a top-level keyword
+ */
+static std::vector<Token> read_condition(TokenStream& stream, const std::vector<std::string>& terminators){
+    std::vector<Token> condition;
+    size_t nesting_level = 0;
+
+    while(!at_statement_end(stream)){
+        const Token& token = stream.peek_token();
+
+        if(nesting_level == 0 && std::ranges::any_of(terminators, [&token](const auto& word){ return is_word(token, word); })){
+            break;
+        }
+
+        update_nesting(token, nesting_level);
+
+        condition.push_back(stream.get_token());
+    }
+
+    return condition;
+}
+
+static std::vector<OrderKey> read_order_by(TokenStream& stream){
+    static const std::vector<std::string> order_terminators = {",", "ASC", "DESC", "NULLS"};
+
+    std::vector<OrderKey> keys;
+
+    while(true){
+        OrderKey key;
+        size_t nesting_level = 0;
+
+        while(!at_statement_end(stream)){
+            const Token& token = stream.peek_token();
+
+            if(nesting_level == 0 && std::ranges::any_of(order_terminators, [&token](const auto& word){ return is_word(token, word); })){
+                break;
+            }
+
+            update_nesting(token, nesting_level);
+
+            if(!key.expression.empty()){
+                key.expression += " ";
+            }
+            key.expression += stream.get_token().get_raw();
+        }
+
+        if(key.expression.empty()){
+            throw InvalidQuery("Missing ORDER BY expression");
+        }
+
+        key.descending = stream.try_ignore_token("DESC");
+        if(!key.descending){
+            stream.try_ignore_token("ASC");
+        }
+
+        key.nulls_first = key.descending;
+        if(stream.try_ignore_token("NULLS")){
+            key.nulls_first = stream.try_ignore_token("FIRST");
+            if(!key.nulls_first){
+                stream.ignore_token("LAST");
+            }
+        }
+
+        keys.push_back(std::move(key));
+
+        if(!stream.try_ignore_token(",")){
+            break;
+        }
+    }
+
+    return keys;
+}
+
+SelectClauses read_select_clauses(TokenStream& stream){
+    SelectClauses clauses;
+
+    stream.ignore_token("SELECT");
+    clauses.distinct = stream.try_ignore_token("DISTINCT");
+    stream.try_ignore_token("ALL");
+
+    clauses.projection = read_projection(stream);
+    clauses.tables = read_tables(stream);
+
+    if(stream.try_ignore_token("WHERE")){
+        clauses.where = read_condition(stream, {"GROUP", "ORDER"});
+    }
+
+    if(stream.try_ignore_token("GROUP")){
+        stream.ignore_token("BY");
+
+        while(true){
+            clauses.group_by.push_back(stream.get_token(TokenType::Identifier));
+
+            if(!stream.try_ignore_token(",")){
+                break;
+            }
+        }
+
+        if(stream.try_ignore_token("HAVING")){
+            clauses.having = read_condition(stream, {"ORDER"});
+        }
+    }
+
+    if(stream.try_ignore_token("ORDER")){
+        stream.ignore_token("BY");
+        clauses.order_by = read_order_by(stream);
+    }
+
+    if(!at_statement_end(stream)){
+        throw InvalidQuery("Unexpected token " + stream.peek_token().get_value());
+    }
+
+    return clauses;
+}
+
+std::vector<std::vector<Token>> split_conjuncts(const std::vector<Token>& condition){
+    std::vector<std::vector<Token>> result(1);
+    size_t nesting_level = 0;
+    bool in_between = false;
+
+    for(const Token& token : condition){
+        update_nesting(token, nesting_level);
+
+        if(nesting_level == 0 && is_word(token, "OR")){
+            return {condition};
+        }
+        if(nesting_level == 0 && is_word(token, "BETWEEN")){
+            in_between = true;
+        }
+        if(nesting_level == 0 && is_word(token, "AND")){
+            if(in_between){
+                // AND belonging to BETWEEN
+                in_between = false;
+            }
+            else{
+                result.emplace_back();
+                continue;
+            }
+        }
+
+        result.back().push_back(token);
+    }
+
+    return result;
+}
+
+std::string tokens_to_string(const std::vector<Token>& tokens){
+    std::string result;
+
+    for(const Token& token : tokens){
+        if(!result.empty()){
+            result += " ";
+        }
+        result += token.get_raw();
+    }
+
+    return result;
+}
+
+std::string tokens_to_column_name(const std::vector<Token>& tokens){
+    if(tokens.size() != 1 && tokens.size() != 3){
+        return "";
+    }
+
+    for(const Token& token : {tokens.front(), tokens.back()}){
+        if(token.get_type() != TokenType::Identifier || is_keyword(token.get_value())){
+            return "";
+        }
+    }
+
+    if(tokens.size() == 1){
+        return tokens[0].get_value();
+    }
+
+    if(!is_word(tokens[1], ".")){
+        return "";
+    }
+
+    return tokens[0].get_value() + "." + tokens[2].get_value();
+}
+
+bool has_aggregate(const std::vector<std::string>& expressions){
+    auto contains = [](const std::string& str, const std::string& substr) {
+        return str.find(substr) != std::string::npos;
+    };
+
+    const std::vector<std::string> aggregate_functions = {"COUNT", "SUM", "AVG", "MAX", "MIN"};
+
+    for(auto&& expr : expressions){
+        auto upper = to_upper(expr);
+
+        for(const auto& aggregate_function : aggregate_functions){
+            if(contains(upper, aggregate_function)){
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+/**
+ * @brief Add the identifiers and the qualified names among the tokens to a set
+ */
+static void add_names(const std::vector<Token>& tokens, std::set<std::string>& names){
+    for(size_t i = 0; i < tokens.size(); ++i){
+        if(tokens[i].get_type() != TokenType::Identifier){
+            continue;
+        }
+
+        names.insert(tokens[i].get_value());
+
+        if(i + 2 < tokens.size() && is_word(tokens[i + 1], ".")){
+            names.insert(tokens[i].get_value() + "." + tokens[i + 2].get_value());
+        }
+    }
+}
+
+/**
+ * @brief Split an expression into tokens
+ */
+static std::vector<Token> read_tokens(const std::string& expression){
+    TokenStream stream(expression);
+    std::vector<Token> tokens;
+
+    while(!stream.empty()){
+        tokens.push_back(stream.get_token());
+    }
+
+    return tokens;
+}
+
+std::optional<std::set<std::string>> get_referenced_names(const SelectClauses& clauses){
+    std::set<std::string> names;
+
+    for(const auto& expression : clauses.projection){
+        if(expression == "*"){
+            return std::nullopt;
+        }
+
+        add_names(read_tokens(expression), names);
+    }
+
+    for(const auto& key : clauses.order_by){
+        add_names(read_tokens(key.expression), names);
+    }
+
+    add_names(clauses.where, names);
+    add_names(clauses.having, names);
+    names.insert(clauses.group_by.begin(), clauses.group_by.end());
+
+    return names;
+}
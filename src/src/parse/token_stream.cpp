@@ -150,6 +150,10 @@ Token TokenStream::get_special_char(){
     return {TokenType::SpecialChar, result};
 }
 
+bool is_word(const Token& token, const std::string& word){
+    return token.get_type() != TokenType::String && token.like(word);
+}
+
 void TokenStream::ignore_token(const Token& token) {
     Token next = peek_token();
     
@@ -163,7 +167,7 @@ void TokenStream::ignore_token(const Token& token) {
 void TokenStream::ignore_token(const std::string& token) {
     Token next = peek_token();
     
-    if(!next.like(token)){
+    if(!is_word(next, token)){
         throw InvalidQuery("Expected token " + token + ", got " + next.get_value());
     }
     
@@ -184,7 +188,7 @@ bool TokenStream::try_ignore_token(const Token& token) {
 bool TokenStream::try_ignore_token(const std::string& token) {
     Token next = peek_token();
     
-    if(!next.like(token)){
+    if(!is_word(next, token)){
         return false;
     }
     
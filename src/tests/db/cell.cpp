@@ -3,6 +3,7 @@
 #include <iostream>
 
 #include "db/cell.h"
+#include "db/cell_set.h"
 
 using enum Cell::DataType;
 using DataType = Cell::DataType;
@@ -76,4 +77,27 @@ TEST_CASE("Cell comparisions"){
             CHECK(!(op(i, null)));
         }
     }
-}
\ No newline at end of file
+}
+
+TEST_CASE("Distinct values"){
+    DistinctValues values;
+    
+    CHECK(values.insert(Cell(3, Int)));
+    CHECK(values.insert(Cell(1, Int)));
+    CHECK_FALSE(values.insert(Cell(3, Int)));
+    CHECK(values.size() == 2);
+    
+    // values of other types move the values to a hash set of cells
+    CHECK(values.insert(Cell((float)3, Float)));
+    CHECK(values.insert(Cell()));
+    CHECK_FALSE(values.insert(Cell()));
+    CHECK_FALSE(values.insert(Cell(1, Int)));
+    CHECK(values.insert(Cell("a", String)));
+    
+    std::vector<Cell> expected = {Cell(3, Int), Cell(1, Int), Cell((float)3, Float), Cell(), Cell("a", String)};
+    
+    REQUIRE(values.size() == expected.size());
+    for(size_t i = 0; i < expected.size(); ++i){
+        CHECK(Cell::is_identical(values.get_values()[i], expected[i]));
+    }
+}
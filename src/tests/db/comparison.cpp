@@ -0,0 +1,132 @@
+#include "doctest.h"
+
+#include "db/comparison.h"
+
+#include <algorithm>
+#include <functional>
+
+using enum Cell::DataType;
+
+TEST_CASE("Typed column comparisons agree with Cell operators"){
+    CellVector values = {
+        Cell(2, Int), Cell(3, Int), Cell((float)2.5, Float), Cell("12", String),
+        Cell("abc", String), Cell('e', Char), Cell('E', Char), Cell()
+    };
+    
+    const std::vector<std::pair<ComparisonOperator, std::function<bool(const Cell&, const Cell&)>>> operators = {
+        {ComparisonOperator::Less, std::less<Cell>()},
+        {ComparisonOperator::Equal, std::equal_to<Cell>()},
+        {ComparisonOperator::Greater, std::greater<Cell>()},
+        {ComparisonOperator::LessEqual, std::less_equal<Cell>()},
+        {ComparisonOperator::GreaterEqual, std::greater_equal<Cell>()},
+        {ComparisonOperator::NotEqual, std::not_equal_to<Cell>()}
+    };
+    
+    for(auto&& [op, reference] : operators){
+        for(const Cell& left : values){
+            for(const Cell& right : values){
+                // homogeneous columns take the specialized path
+                CellVector left_column(left, 3);
+                CellVector right_column(right, 3);
+                
+                BoolVector result = compare_columns(op, left_column, right_column);
+                
+                for(bool value : result){
+                    CHECK(value == reference(left, right));
+                }
+                
+                CHECK(compare_cells(op, left, right) == reference(left, right));
+            }
+        }
+        
+        // mixed columns take the generic path
+        BoolVector mixed = compare_columns(op, values, values);
+        for(size_t i = 0; i < values.size(); ++i){
+            CHECK(mixed[i] == reference(values[i], values[i]));
+        }
+    }
+}
+
+TEST_CASE("BETWEEN and quantified comparisons"){
+    CellVector values = {Cell(1, Int), Cell(5, Int), Cell(), Cell(10, Int)};
+    CellVector lower(Cell(2, Int), 4);
+    CellVector upper(Cell((float)9.5, Float), 4);
+    
+    BoolVector between = between_columns(values, lower, upper);
+    CHECK(!between[0]);
+    CHECK(between[1]);
+    CHECK(!between[2]);
+    CHECK(!between[3]);
+    
+    std::vector<Cell> list = {Cell(2, Int), Cell(6, Int)};
+    std::vector<std::vector<Cell>> lists(values.size(), list);
+    lists[3] = {};
+    
+    BoolVector any = compare_quantified(ComparisonOperator::Greater, values, lists, true);
+    BoolVector all = compare_quantified(ComparisonOperator::Greater, values, lists, false);
+    
+    CHECK(!any[0]);
+    CHECK(any[1]);
+    CHECK(!all[1]);
+    CHECK(!any[2]);
+    CHECK(!any[3]);
+    CHECK(all[3]);
+    
+    BoolVector shared_any = compare_quantified(ComparisonOperator::Greater, values, list, true);
+    BoolVector shared_all = compare_quantified(ComparisonOperator::Greater, values, list, false);
+    
+    CHECK(!shared_any[0]);
+    CHECK(shared_any[1]);
+    CHECK(!shared_all[1]);
+    CHECK(!shared_any[2]);
+    CHECK(shared_all[3]);
+    
+    BoolVector empty = compare_quantified(ComparisonOperator::Greater, values, std::vector<Cell>(), false);
+    CHECK(empty[3]);
+    
+    BoolVector empty_any = compare_quantified(ComparisonOperator::Greater, values, std::vector<Cell>(), true);
+    CHECK(!empty_any[0]);
+}
+
+TEST_CASE("Quantified comparisons match element-wise evaluation"){
+    std::vector<std::vector<Cell>> lists = {
+        {},
+        {Cell()},
+        {Cell(3, Int), Cell(1, Int), Cell(7, Int)},
+        {Cell(3, Int), Cell(), Cell(7, Int)},
+        {Cell(2.5f, Float), Cell(-1.0f, Float)},
+        {Cell(std::string("10"), String), Cell(std::string("9"), String)},
+        {Cell(3, Int), Cell(2.5f, Float)}
+    };
+    
+    std::vector<CellVector> value_columns = {
+        {Cell(0, Int), Cell(3, Int), Cell(8, Int), Cell()},
+        {Cell(2.5f, Float), Cell(7.0f, Float)},
+        {Cell(std::string("10"), String), Cell(std::string("5"), String)},
+        {Cell(1, Int), Cell(std::string("5"), String)}
+    };
+    
+    for(auto op : {ComparisonOperator::Less, ComparisonOperator::Greater, ComparisonOperator::LessEqual,
+            ComparisonOperator::GreaterEqual, ComparisonOperator::Equal, ComparisonOperator::NotEqual}){
+        for(bool any : {true, false}){
+            for(const auto& list : lists){
+                for(const auto& values : value_columns){
+                    std::vector<std::vector<Cell>> per_row(values.size(), list);
+                    
+                    BoolVector shared = compare_quantified(op, values, list, any);
+                    BoolVector separate = compare_quantified(op, values, per_row, any);
+                    
+                    for(size_t i = 0; i < values.size(); ++i){
+                        auto matches = [&](const Cell& other){
+                            return compare_cells(op, values[i], other);
+                        };
+                        bool expected = any ? std::ranges::any_of(list, matches) : std::ranges::all_of(list, matches);
+                        
+                        CHECK(shared[i] == expected);
+                        CHECK(separate[i] == expected);
+                    }
+                }
+            }
+        }
+    }
+}
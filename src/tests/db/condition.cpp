@@ -139,4 +139,36 @@ TEST_CASE("SELECT without FROM is invalid") {
     Database db;
     auto r = db.process_query("SELECT 1+1;");
     CHECK(is_error(r));
-}
\ No newline at end of file
+}
+
+TEST_CASE("IN lists with mixed types and NULLs") {
+    Database db;
+    CHECK(is_ok(db.process_query("CREATE TABLE m(i INT, s STRING, f FLOAT);")));
+    CHECK(is_ok(db.process_query("INSERT INTO m VALUES (1, 'a', 1.5);")));
+    CHECK(is_ok(db.process_query("INSERT INTO m VALUES (2, '2', 2.0);")));
+    CHECK(is_ok(db.process_query("INSERT INTO m () VALUES ();")));
+
+    // typed INT set
+    auto o1 = db.process_query("SELECT i FROM m WHERE i IN (2, 3, 4);");
+    CHECK(o1.find("2,") != std::string::npos);
+    CHECK(o1.find("1,") == std::string::npos);
+    CHECK(o1.find("\\x,") == std::string::npos);
+
+    // typed STRING set
+    auto o2 = db.process_query("SELECT s FROM m WHERE s IN ('a', 'b');");
+    CHECK(o2.find("a,") != std::string::npos);
+    CHECK(o2.find("2,") == std::string::npos);
+
+    // values are promoted before comparison
+    auto o3 = db.process_query("SELECT i FROM m WHERE i IN ('2');");
+    CHECK(o3.find("2,") != std::string::npos);
+    CHECK(o3.find("1,") == std::string::npos);
+
+    auto o4 = db.process_query("SELECT f FROM m WHERE f IN (2, 'x');");
+    CHECK(o4.find("2,") != std::string::npos);
+    CHECK(o4.find("1.5,") == std::string::npos);
+
+    // NULL is never in a list
+    auto o5 = db.process_query("SELECT i FROM m WHERE i NOT IN (1, 2);");
+    CHECK(o5.find("\\x,") != std::string::npos);
+}
@@ -0,0 +1,178 @@
+#include "doctest.h"
+#include "db/database.h"
+
+#include <algorithm>
+#include <sstream>
+#include <vector>
+
+static bool is_ok(const std::string &r)    { return r.rfind("OK ", 0) == 0; }
+static void must_have(const std::string &out, const std::string &sub) {
+    REQUIRE(out.find(sub) != std::string::npos);
+}
+static size_t count_rows(const std::string &out) {
+    // the column names and types take the first two lines
+    return std::count(out.begin(), out.end(), '\n') - 2;
+}
+
+/**
+ * @brief Get the cells of the row of the first operator with the name
+ */
+static std::vector<std::string> find_operator(const std::string &out, const std::string &name) {
+    std::istringstream lines(out);
+    std::string line;
+
+    while (std::getline(lines, line)) {
+        // commas in the cells are escaped, other escapes are kept as they are
+        std::vector<std::string> cells;
+        std::string cell;
+        for (size_t i = 0; i < line.size(); ++i) {
+            if (line[i] == '\\' && i + 1 < line.size()) {
+                if (line[i + 1] != ',') {
+                    cell += line[i];
+                }
+                cell += line[++i];
+            }
+            else if (line[i] == ',') {
+                cells.push_back(std::move(cell));
+                cell.clear();
+            }
+            else {
+                cell += line[i];
+            }
+        }
+        if (cells.size() >= 7 && cells[2] == name) {
+            return cells;
+        }
+    }
+
+    FAIL("operator " << name << " not found");
+    return {};
+}
+
+static void fill_shop(Database& db){
+    db.process_query("CREATE TABLE customer(id INT, name STRING);");
+    db.process_query("CREATE TABLE orders(id INT, cid INT, price INT);");
+
+    for (int i = 0; i < 20; ++i) {
+        db.process_query("INSERT INTO customer VALUES (" + std::to_string(i) + ", 'c" + std::to_string(i) + "');");
+    }
+    for (int i = 0; i < 60; ++i) {
+        db.process_query("INSERT INTO orders VALUES (" + std::to_string(i) + ", " + std::to_string(i % 30)
+            + ", " + std::to_string(i % 7) + ");");
+    }
+}
+
+TEST_CASE("EXPLAIN describes the plan without executing it") {
+    Database db;
+    fill_shop(db);
+
+    auto out = db.process_query(
+        "EXPLAIN SELECT DISTINCT c.name FROM customer c, orders o WHERE c.id = o.cid AND o.price > 2;");
+    CHECK(is_ok(out));
+    must_have(out, "id,parent,operator,details,rows,time_ms,memory_kb,");
+
+    // preorder from the root, the root has no parent
+    must_have(out, "0,\\x,Distinct,");
+    must_have(out, "1,0,Project,");
+    must_have(out, "2,1,Materialize,");
+    must_have(out, "3,2,EquiJoin,");
+
+    auto join = find_operator(out, "EquiJoin");
+    must_have(join[3], "estimated");
+    // nothing is measured
+    CHECK(join[4] == "\\x");
+    CHECK(join[5] == "\\x");
+
+    auto filter = find_operator(out, "Filter");
+    must_have(filter[3], "o . price > 2");
+    CHECK(count_rows(out) == 7);
+
+    // the condition fails only when it's evaluated
+    std::string failing = "SELECT c.name FROM customer c, orders o WHERE c.id = o.cid AND o.price - 'abc' > 0;";
+    CHECK(db.process_query(failing).rfind("ERR", 0) == 0);
+    out = db.process_query("EXPLAIN " + failing);
+    CHECK(is_ok(out));
+    must_have(find_operator(out, "EquiJoin")[3], "estimated");
+
+    out = db.process_query("EXPLAIN SELECT * FROM nothing;");
+    CHECK(out.rfind("ERR", 0) == 0);
+}
+
+TEST_CASE("EXPLAIN ANALYZE reports the measurements of the operators") {
+    Database db;
+    fill_shop(db);
+
+    auto out = db.process_query(
+        "EXPLAIN ANALYZE SELECT cid, COUNT(price) FROM customer c, orders o "
+        "WHERE c.id = o.cid AND o.price > 2 GROUP BY cid HAVING COUNT(price) > 1;");
+    CHECK(is_ok(out));
+
+    // orders with price 3..6 are the ids with id % 7 >= 3, 23 of them have cid = id % 30 below 20
+    auto scan = find_operator(out, "Scan");
+    CHECK(scan[4] == "20");
+
+    auto filter = find_operator(out, "Filter");
+    CHECK(filter[4] == "33");
+
+    auto join = find_operator(out, "HashJoin");
+    CHECK(join[4] == "23");
+    CHECK(join[5] != "\\x");
+    CHECK(join[6] != "\\x");
+
+    auto group = find_operator(out, "Group");
+    CHECK(group[4] == "17");
+
+    auto having = find_operator(out, "Having");
+    CHECK(having[4] == "6");
+
+    auto aggregate = find_operator(out, "Aggregate");
+    CHECK(aggregate[4] == "6");
+    CHECK(aggregate[1] == "\\x");
+
+    // the statement is evaluated exactly as without EXPLAIN
+    auto plain = db.process_query(
+        "SELECT cid, COUNT(price) FROM customer c, orders o "
+        "WHERE c.id = o.cid AND o.price > 2 GROUP BY cid HAVING COUNT(price) > 1;");
+    CHECK(count_rows(plain) == 6);
+}
+
+TEST_CASE("EXPLAIN ANALYZE measures subqueries") {
+    Database db;
+    fill_shop(db);
+
+    auto out = db.process_query(
+        "EXPLAIN ANALYZE SELECT id FROM customer c "
+        "WHERE EXISTS (SELECT id FROM orders WHERE cid = c.id AND price = 0);");
+    CHECK(is_ok(out));
+
+    auto filter = find_operator(out, "Filter");
+    CHECK(filter[4] == "6");
+
+    auto subquery = find_operator(out, "Subquery");
+    CHECK(subquery[1] == filter[0]);
+    must_have(subquery[3], "executed");
+
+    auto scan = find_operator(out, "Scan");
+    CHECK(scan[4] == "20");
+}
+
+TEST_CASE("An uncorrelated subquery runs once for all the batches") {
+    Database db;
+    fill_shop(db);
+
+    ExecutionSettings settings;
+    settings.batch_rows = 4;
+    db.set_settings(settings);
+
+    auto out = db.process_query(
+        "EXPLAIN ANALYZE SELECT o.id FROM customer c, orders o "
+        "WHERE c.id = o.cid AND o.price + c.id > (SELECT MIN(x.price) FROM orders x);");
+    CHECK(is_ok(out));
+
+    // the join produces 40 rows, ten batches
+    auto join = find_operator(out, "HashJoin");
+    CHECK(join[4] == "40");
+
+    auto subquery = find_operator(out, "Subquery");
+    CHECK(subquery[3] == "executed 1 times");
+}
@@ -0,0 +1,538 @@
+#include "doctest.h"
+#include "db/database.h"
+#include "db/join.h"
+
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+
+static bool is_ok(const std::string &r)    { return r.rfind("OK ", 0) == 0; }
+static void must_have(const std::string &out, const std::string &sub) {
+    REQUIRE(out.find(sub) != std::string::npos);
+}
+static void must_not_have(const std::string &out, const std::string &sub) {
+    REQUIRE(out.find(sub) == std::string::npos);
+}
+static size_t count_rows(const std::string &out) {
+    // the column names and types take the first two lines
+    return std::count(out.begin(), out.end(), '\n') - 2;
+}
+
+static void fill_shop(Database& db){
+    db.process_query("CREATE TABLE customer(id INT, name STRING);");
+    db.process_query("CREATE TABLE orders(id INT, cid FLOAT, item STRING);");
+    db.process_query("CREATE TABLE item(name STRING, price INT);");
+
+    db.process_query("INSERT INTO customer VALUES (1, 'ann');");
+    db.process_query("INSERT INTO customer VALUES (2, 'ben');");
+    db.process_query("INSERT INTO customer (name) VALUES ('dan');");
+
+    db.process_query("INSERT INTO orders VALUES (10, 1, 'pen');");
+    db.process_query("INSERT INTO orders VALUES (11, 1, 'ink');");
+    db.process_query("INSERT INTO orders VALUES (12, 2, 'pad');");
+    db.process_query("INSERT INTO orders (id, item) VALUES (13, 'box');");
+
+    db.process_query("INSERT INTO item VALUES ('pen', 3);");
+    db.process_query("INSERT INTO item VALUES ('ink', 7);");
+    db.process_query("INSERT INTO item VALUES ('box', 9);");
+}
+
+TEST_CASE("Equi-joins keep the result of the filtered cross product") {
+    Database db;
+    fill_shop(db);
+
+    auto out = db.process_query("SELECT * FROM customer c, orders o WHERE c.id = o.cid;");
+    CHECK(is_ok(out));
+    // columns stay in the FROM order
+    must_have(out, "c.id,c.name,o.id,o.cid,o.item,");
+    must_have(out, "1,ann,10,1,pen,");
+    must_have(out, "1,ann,11,1,ink,");
+    must_have(out, "2,ben,12,2,pad,");
+    // NULL keys match nothing
+    must_not_have(out, "dan");
+    must_not_have(out, "box");
+    CHECK(count_rows(out) == 3);
+
+    // three tables with the other conditions applied afterwards
+    out = db.process_query(
+        "SELECT c.name, i.price FROM orders o, item i, customer c "
+        "WHERE o.item = i.name AND c.id = o.cid AND i.price > 5;");
+    CHECK(is_ok(out));
+    must_have(out, "ann,7,");
+    CHECK(count_rows(out) == 1);
+
+    // several equalities between the same tables and a cycle
+    out = db.process_query(
+        "SELECT o.id FROM orders o, orders p, customer c "
+        "WHERE o.cid = p.cid AND p.item = o.item AND c.id = o.cid AND c.id = p.cid;");
+    CHECK(is_ok(out));
+    CHECK(count_rows(out) == 3);
+
+    // tables not connected by a join are still combined
+    out = db.process_query("SELECT c.name, o.item FROM customer c, orders o, item i WHERE o.item = i.name;");
+    CHECK(is_ok(out));
+    CHECK(count_rows(out) == 9);
+}
+
+TEST_CASE("Conditions that aren't equi-joins") {
+    Database db;
+    fill_shop(db);
+
+    // OR is evaluated on the cross product
+    auto out = db.process_query("SELECT o.id FROM customer c, orders o WHERE c.id = o.cid OR o.id = 13;");
+    CHECK(is_ok(out));
+    CHECK(count_rows(out) == 6);
+
+    // an unqualified name of two tables is still reported
+    CHECK(!is_ok(db.process_query("SELECT * FROM customer c, orders o WHERE id = o.cid;")));
+
+    // equality of columns of one table
+    out = db.process_query("SELECT c.name FROM customer c, orders o WHERE o.id = o.cid;");
+    CHECK(is_ok(out));
+    CHECK(count_rows(out) == 0);
+}
+
+TEST_CASE("Equi-joins of larger tables") {
+    Database db;
+    db.process_query("CREATE TABLE a(id INT, v INT);");
+    db.process_query("CREATE TABLE b(id INT, a_id INT);");
+    db.process_query("CREATE TABLE c(b_id INT);");
+
+    for(int i = 0; i < 300; ++i){
+        std::string value = std::to_string(i);
+        db.process_query("INSERT INTO a VALUES (" + value + ", " + std::to_string(i % 7) + ");");
+        db.process_query("INSERT INTO b VALUES (" + value + ", " + std::to_string(i / 2) + ");");
+        db.process_query("INSERT INTO c VALUES (" + value + ");");
+    }
+
+    // the cross product would have 27 million rows
+    auto out = db.process_query("SELECT a.id FROM a, b, c WHERE a.id = b.a_id AND b.id = c.b_id AND a.v = 0;");
+    CHECK(is_ok(out));
+    CHECK(count_rows(out) == 44);
+
+    out = db.process_query("SELECT a.id FROM a, b WHERE EXISTS (SELECT * FROM c WHERE c.b_id = b.id) AND a.id = b.a_id;");
+    CHECK(is_ok(out));
+    CHECK(count_rows(out) == 300);
+}
+
+TEST_CASE("Band joins and merge joins") {
+    Database db;
+    db.process_query("CREATE TABLE event(ts INT, name STRING);");
+    db.process_query("CREATE TABLE period(start INT, finish INT, label STRING);");
+
+    for(int i = 0; i < 50; ++i){
+        db.process_query("INSERT INTO event VALUES (" + std::to_string(i * 3) + ", 'e" + std::to_string(i) + "');");
+    }
+    db.process_query("INSERT INTO period VALUES (0, 10, 'early');");
+    db.process_query("INSERT INTO period VALUES (100, 110, 'late');");
+    db.process_query("INSERT INTO period VALUES (50, 40, 'empty');");
+    db.process_query("INSERT INTO period (start, label) VALUES (0, 'open');");
+
+    auto out = db.process_query("SELECT p.label, e.name FROM event e, period p WHERE e.ts BETWEEN p.start AND p.finish;");
+    CHECK(is_ok(out));
+    must_have(out, "early,e0,");
+    must_have(out, "early,e3,");
+    must_have(out, "late,e34,");
+    must_not_have(out, "empty");
+    must_not_have(out, "open");
+    CHECK(count_rows(out) == 7);
+
+    // a hash table over the budget is replaced by joining partitions spilled to disk
+    Database small;
+    fill_shop(small);
+    auto expected = small.process_query("SELECT c.name, o.item FROM customer c, orders o WHERE c.id = o.cid;");
+
+    auto spill_directory = std::filesystem::temp_directory_path() / "simpledb_join_test";
+    std::filesystem::create_directories(spill_directory);
+
+    small.set_settings({.memory_budget = 0, .spill_directory = spill_directory});
+    auto spilled = small.process_query("SELECT c.name, o.item FROM customer c, orders o WHERE c.id = o.cid;");
+    CHECK(is_ok(spilled));
+    CHECK(count_rows(spilled) == count_rows(expected));
+    must_have(spilled, "ann,pen,");
+    must_have(spilled, "ben,pad,");
+
+    // the temporary files are removed
+    CHECK(std::filesystem::is_empty(spill_directory));
+    std::filesystem::remove(spill_directory);
+}
+
+TEST_CASE("Join order") {
+    Database db;
+    db.process_query("CREATE TABLE a(k INT, g INT);");
+    db.process_query("CREATE TABLE b(g INT, k INT);");
+    db.process_query("CREATE TABLE c(k INT);");
+
+    for(int i = 0; i < 1000; ++i){
+        db.process_query("INSERT INTO a VALUES (" + std::to_string(i) + ", " + std::to_string(i % 2) + ");");
+        db.process_query("INSERT INTO b VALUES (" + std::to_string(i % 2) + ", " + std::to_string(i) + ");");
+    }
+    db.process_query("INSERT INTO c VALUES (7);");
+
+    // joining a and b first would give half a million rows
+    auto out = db.process_query("SELECT a.k, b.k FROM a, b, c WHERE a.g = b.g AND a.k = c.k AND b.k = c.k;");
+    CHECK(is_ok(out));
+    must_have(out, "7,7,");
+    CHECK(count_rows(out) == 1);
+
+    // a chain too long for the exhaustive search
+    std::string from;
+    std::string where;
+    for(int i = 0; i < 12; ++i){
+        std::string name = "t" + std::to_string(i);
+        db.process_query("CREATE TABLE " + name + "(v INT);");
+        for(int j = 0; j < 5; ++j){
+            db.process_query("INSERT INTO " + name + " VALUES (" + std::to_string(j + i % 2) + ");");
+        }
+
+        from += (i == 0 ? "" : ", ") + name;
+        if(i != 0){
+            where += (i == 1 ? "" : " AND ") + name + ".v = t" + std::to_string(i - 1) + ".v";
+        }
+    }
+
+    out = db.process_query("SELECT t0.v FROM " + from + " WHERE " + where + ";");
+    CHECK(is_ok(out));
+    // values 1 to 4 appear in all the tables
+    CHECK(count_rows(out) == 4);
+}
+
+TEST_CASE("Conditions of single tables are applied before joining") {
+    Database db;
+    fill_shop(db);
+
+    auto out = db.process_query(
+        "SELECT c.name, o.item FROM customer c, orders o WHERE c.name LIKE 'a%' AND o.item <> 'ink' AND c.id = o.cid;");
+    CHECK(is_ok(out));
+    must_have(out, "ann,pen,");
+    CHECK(count_rows(out) == 1);
+
+    // without any join the filtered tables form the cross product
+    out = db.process_query("SELECT c.name, o.id FROM customer c, orders o WHERE c.id IS NOT NULL AND o.id > 11;");
+    CHECK(is_ok(out));
+    CHECK(count_rows(out) == 4);
+
+    // a condition of one table using a variable of the outer query
+    out = db.process_query(
+        "SELECT c.name FROM customer c WHERE EXISTS "
+        "(SELECT * FROM orders o, item i WHERE o.cid = c.id AND i.price > c.id * 5 AND o.item = i.name);");
+    CHECK(is_ok(out));
+    must_have(out, "ann,");
+    CHECK(count_rows(out) == 1);
+
+    // conditions of several tables and misspelled names behave as before
+    CHECK(!is_ok(db.process_query("SELECT * FROM customer c, orders o WHERE c.idd = 1;")));
+    out = db.process_query("SELECT o.id FROM customer c, orders o WHERE c.id + o.id = 12;");
+    CHECK(is_ok(out));
+    CHECK(count_rows(out) == 2);
+}
+
+TEST_CASE("Only the referenced columns are joined") {
+    Database db;
+    fill_shop(db);
+
+    // columns of one table are pruned while the names of the other stay unique
+    auto out = db.process_query("SELECT c.name FROM customer c, orders o WHERE c.id = o.cid AND o.item <> 'ink';");
+    CHECK(is_ok(out));
+    must_have(out, "ann,");
+    must_have(out, "ben,");
+    CHECK(count_rows(out) == 2);
+
+    // an unqualified name shared by two tables is still ambiguous
+    CHECK(!is_ok(db.process_query("SELECT id FROM customer c, orders o WHERE c.id = o.cid;")));
+    CHECK(!is_ok(db.process_query("SELECT c.name FROM customer c, orders o WHERE c.id = o.cid GROUP BY id;")));
+
+    // the star keeps all the columns
+    out = db.process_query("SELECT * FROM customer c, orders o WHERE o.item = 'pad';");
+    CHECK(is_ok(out));
+    must_have(out, "c.id,c.name,o.id,o.cid,o.item,");
+    CHECK(count_rows(out) == 3);
+
+    // columns used only in HAVING, GROUP BY or a subquery
+    out = db.process_query(
+        "SELECT cid, COUNT(item) FROM customer c, orders o WHERE c.id = o.cid GROUP BY cid HAVING MAX(name) = 'ann';");
+    CHECK(is_ok(out));
+    must_have(out, "1,2,");
+    CHECK(count_rows(out) == 1);
+
+    out = db.process_query(
+        "SELECT o.id FROM orders o, item i WHERE o.item = i.name AND EXISTS (SELECT * FROM customer c WHERE c.id = o.cid);");
+    CHECK(is_ok(out));
+    CHECK(count_rows(out) == 2);
+
+    // without a join only the referenced columns form the cross product
+    out = db.process_query("SELECT COUNT(*) FROM customer c, orders o, item i;");
+    CHECK(is_ok(out));
+    must_have(out, "36,");
+}
+
+TEST_CASE("Other conditions of two tables are joined by nested loops") {
+    Database db;
+    db.process_query("CREATE TABLE a(x INT, tag STRING);");
+    db.process_query("CREATE TABLE b(y INT);");
+    db.process_query("CREATE TABLE c(y INT, z INT);");
+
+    for(int i = 0; i < 200; ++i){
+        db.process_query("INSERT INTO a VALUES (" + std::to_string(i) + ", 't" + std::to_string(i % 3) + "');");
+    }
+    for(int i = 0; i < 600; ++i){
+        db.process_query("INSERT INTO b VALUES (" + std::to_string(i % 100) + ");");
+        db.process_query("INSERT INTO c VALUES (" + std::to_string(i) + ", " + std::to_string(i % 10) + ");");
+    }
+    db.process_query("INSERT INTO a (tag) VALUES ('null');");
+
+    // spans several tiles of both tables
+    auto out = db.process_query("SELECT a.x FROM a, b WHERE a.x < b.y;");
+    CHECK(is_ok(out));
+    CHECK(count_rows(out) == 6 * 4950);
+
+    // several conditions of the same tables together with a filter and an equi-join
+    out = db.process_query(
+        "SELECT a.x, c.z FROM a, b, c WHERE a.x * 2 > b.y AND a.x <= b.y AND b.y = c.y AND a.tag = 't0';");
+    CHECK(is_ok(out));
+    must_have(out, "99,9,");
+    must_not_have(out, "null");
+    // each b.y in [x, 2x) for x divisible by 3, six rows of b for each value
+    CHECK(count_rows(out) == 4998);
+
+    // a condition of the joined tables that is also a join
+    out = db.process_query("SELECT a.x FROM a, c WHERE a.x = c.y AND a.x + c.z > 195;");
+    CHECK(is_ok(out));
+    CHECK(count_rows(out) == 9);
+}
+
+TEST_CASE("Small groups are joined through indexes of large tables") {
+    Database db;
+    db.process_query("CREATE TABLE big(id INT, v STRING);");
+    db.process_query("CREATE TABLE small(ref FLOAT, lo INT, hi INT);");
+
+    for(int i = 0; i < 1000; ++i){
+        db.process_query("INSERT INTO big VALUES (" + std::to_string(i % 500) + ", 'v" + std::to_string(i) + "');");
+    }
+    db.process_query("INSERT INTO big (v) VALUES ('none');");
+    db.process_query("INSERT INTO small VALUES (7, 10, 12);");
+    db.process_query("INSERT INTO small VALUES (499, 600, 500);");
+    db.process_query("INSERT INTO small (lo, hi) VALUES (1, 2);");
+
+    auto out = db.process_query("SELECT s.ref, b.v FROM small s, big b WHERE b.id = s.ref;");
+    CHECK(is_ok(out));
+    must_have(out, "7,v7,");
+    must_have(out, "7,v507,");
+    must_have(out, "499,v999,");
+    CHECK(count_rows(out) == 4);
+
+    out = db.process_query("SELECT b.v FROM small s, big b WHERE b.id BETWEEN s.lo AND s.hi;");
+    CHECK(is_ok(out));
+    must_have(out, "v10,");
+    must_have(out, "v512,");
+    must_have(out, "v2,");
+    CHECK(count_rows(out) == 10);
+
+    // the kept index follows the changes of the table
+    db.process_query("INSERT INTO big VALUES (7, 'new');");
+    db.process_query("DELETE FROM big WHERE v = 'v507';");
+
+    out = db.process_query("SELECT s.ref, b.v FROM small s, big b WHERE b.id = s.ref;");
+    CHECK(is_ok(out));
+    must_have(out, "7,new,");
+    must_not_have(out, "v507");
+    CHECK(count_rows(out) == 4);
+
+    // a filtered table is scanned
+    out = db.process_query("SELECT b.v FROM small s, big b WHERE b.id = s.ref AND b.v <> 'new';");
+    CHECK(is_ok(out));
+    CHECK(count_rows(out) == 3);
+}
+
+TEST_CASE("Joined rows are filtered and projected in batches") {
+    Database db;
+    fill_shop(db);
+
+    std::vector<std::string> queries = {
+        "SELECT c.name, o.item FROM customer c, orders o WHERE c.id = o.cid;",
+        "SELECT c.name, o.item FROM customer c, orders o WHERE c.id = o.cid AND o.item LIKE '%n%';",
+        "SELECT c.name, i.price FROM customer c, item i;",
+        "SELECT c.name, i.price FROM customer c, item i WHERE i.price * c.id > 6;",
+        "SELECT * FROM customer;",
+        "SELECT DISTINCT c.name FROM customer c, orders o WHERE c.id = o.cid;",
+        "SELECT COUNT(price), SUM(price) FROM orders o, item i WHERE o.item = i.name;",
+        "SELECT name FROM customer c WHERE id > 5;",
+    };
+
+    std::vector<std::string> expected;
+    for (const auto& query : queries) {
+        expected.push_back(db.process_query(query));
+        CHECK(is_ok(expected.back()));
+    }
+
+    // batches of a single row and of two rows give the same results in the same order
+    for (size_t batch_rows : {1, 2}) {
+        ExecutionSettings settings;
+        settings.batch_rows = batch_rows;
+        db.set_settings(settings);
+
+        for (size_t i = 0; i < queries.size(); ++i) {
+            CHECK(db.process_query(queries[i]) == expected[i]);
+        }
+    }
+}
+
+TEST_CASE("Morsels of large tables are processed in parallel in order") {
+    Database db;
+    db.process_query("CREATE TABLE n(id INT, v STRING);");
+    db.process_query("CREATE TABLE m(k INT);");
+
+    for (int i = 0; i < 3000; ++i) {
+        db.process_query("INSERT INTO n VALUES (" + std::to_string(i) + ", 'v" + std::to_string(i % 10) + "');");
+    }
+    for (int i = 0; i < 3000; i += 7) {
+        db.process_query("INSERT INTO m VALUES (" + std::to_string(i) + ");");
+    }
+
+    std::vector<std::string> queries = {
+        "SELECT id, v FROM n WHERE id - id / 3 * 3 = 0;",
+        "SELECT a.id, b.k FROM n a, m b WHERE a.id = b.k AND a.v <> 'v3';",
+        "SELECT id FROM n a WHERE EXISTS (SELECT k FROM m WHERE k = a.id);",
+        "SELECT COUNT(id), MAX(id) FROM n WHERE v = 'v1';",
+        "SELECT a.id, b.k FROM n a, m b WHERE a.id = b.k AND a.id IN (SELECT c.id FROM n c WHERE c.v = 'v0');",
+    };
+
+    ExecutionSettings settings;
+    settings.batch_rows = 1 << 20;
+    db.set_settings(settings);
+
+    std::vector<std::string> expected;
+    for (const auto& query : queries) {
+        expected.push_back(db.process_query(query));
+        CHECK(is_ok(expected.back()));
+    }
+    CHECK(count_rows(expected[0]) == 1000);
+    CHECK(count_rows(expected[1]) == 387);
+    CHECK(count_rows(expected[2]) == 429);
+    must_have(expected[3], "300,2991,");
+    CHECK(count_rows(expected[4]) == 43);
+
+    settings.batch_rows = 97;
+    db.set_settings(settings);
+
+    for (size_t i = 0; i < queries.size(); ++i) {
+        CHECK(db.process_query(queries[i]) == expected[i]);
+    }
+}
+
+TEST_CASE("Groups of parallel morsels are merged by partitions") {
+    Database db;
+    db.process_query("CREATE TABLE n(id INT, v STRING);");
+    db.process_query("CREATE TABLE m(k INT);");
+
+    for (int i = 0; i < 3000; ++i) {
+        db.process_query("INSERT INTO n VALUES (" + std::to_string(i) + ", 'v" + std::to_string(i % 10) + "');");
+    }
+    for (int i = 0; i < 3000; i += 7) {
+        db.process_query("INSERT INTO m VALUES (" + std::to_string(i % 100) + ");");
+    }
+
+    std::vector<std::string> queries = {
+        "SELECT v, COUNT(*), SUM(id), MIN(id), MAX(id), AVG(id) FROM n GROUP BY v;",
+        "SELECT id, COUNT(*), SUM(id) FROM n GROUP BY id HAVING SUM(id) > 2900;",
+        "SELECT v, COUNT(DISTINCT id) FROM n WHERE id < 1000 GROUP BY v;",
+        "SELECT k, COUNT(*), MAX(id) FROM n a, m b WHERE a.id = b.k GROUP BY k;",
+    };
+
+    ExecutionSettings settings;
+    settings.batch_rows = 1 << 20;
+    db.set_settings(settings);
+
+    std::vector<std::string> expected;
+    for (const auto& query : queries) {
+        expected.push_back(db.process_query(query));
+        CHECK(is_ok(expected.back()));
+    }
+    CHECK(count_rows(expected[0]) == 10);
+    must_have(expected[0], "v1,300,448800,1,2991,1496,");
+    CHECK(count_rows(expected[1]) == 99);
+    must_have(expected[2], "v7,100,");
+    CHECK(count_rows(expected[3]) == 100);
+
+    // many morsels with many groups each, merged in many partitions
+    settings.batch_rows = 97;
+    settings.cache_bytes = 1024;
+    db.set_settings(settings);
+
+    for (size_t i = 0; i < queries.size(); ++i) {
+        CHECK(db.process_query(queries[i]) == expected[i]);
+    }
+}
+
+/**
+ * @brief Check if no scan of the plan has read its table
+ */
+static bool nothing_scanned(const PlanNode& node) {
+    if (node.name == "Scan" && node.statistics.rows.has_value()) {
+        return false;
+    }
+    return std::ranges::all_of(node.children, nothing_scanned);
+}
+
+TEST_CASE("A cross product copies the referenced columns only when it's executed") {
+    Table left({{Cell::DataType::Int, "a"}, {Cell::DataType::String, "b"}});
+    Table right({{Cell::DataType::Int, "c"}});
+    for (int i = 0; i < 3; ++i) {
+        left.add_row(std::vector<std::string>{std::to_string(i), "x"});
+        right.add_row(std::vector<std::string>{std::to_string(i)});
+    }
+
+    VariableList variables;
+    SelectCallback callback = [](TokenStream&, const VariableList&, SelectMode) -> Table {
+        throw std::logic_error("no subqueries");
+    };
+
+    // the first-row search of an EXISTS subquery builds the planner, but doesn't execute it
+    JoinPlanner planner({{left, "l"}, {right, "r"}}, {}, std::set<std::string>{"a", "c"}, variables, callback,
+        ExecutionSettings());
+    CHECK(!planner.avoids_cross_product());
+    CHECK(nothing_scanned(planner.get_plan()));
+
+    std::atomic<size_t> rows = 0;
+    planner.execute([&](size_t, Table batch) {
+        CHECK(batch.get_header().column_count() == 2);
+        rows += batch.get_rows().size();
+    });
+    CHECK(rows == 9);
+    CHECK(!nothing_scanned(planner.get_plan()));
+}
+
+TEST_CASE("A stopped planner skips the remaining batches") {
+    Table left({{Cell::DataType::Int, "a"}});
+    Table right({{Cell::DataType::Int, "b"}});
+    for (int i = 0; i < 100; ++i) {
+        left.add_row(std::vector<std::string>{std::to_string(i)});
+        right.add_row(std::vector<std::string>{std::to_string(i)});
+    }
+
+    VariableList variables;
+    SelectCallback callback = [](TokenStream&, const VariableList&, SelectMode) -> Table {
+        throw std::logic_error("no subqueries");
+    };
+
+    ExecutionSettings settings;
+    settings.batch_rows = 10;
+
+    std::vector<Token> condition;
+    TokenStream stream("l.a = r.b");
+    while (!stream.empty()) {
+        condition.push_back(stream.get_token());
+    }
+
+    JoinPlanner planner({{left, "l"}, {right, "r"}}, condition, std::nullopt, variables, callback, settings);
+    REQUIRE(planner.avoids_cross_product());
+
+    // the batches already being made on other threads are still consumed
+    std::atomic<size_t> batches = 0;
+    planner.execute([&](size_t, Table) {
+        batches++;
+        planner.stop();
+    });
+    CHECK(batches >= 1);
+    CHECK(batches < 10);
+}
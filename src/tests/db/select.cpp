@@ -2,6 +2,14 @@
 #include "doctest.h"
 #include "db/database.h"  
 
+#include <algorithm>
+#include <filesystem>
+#include <functional>
+#include <optional>
+#include <set>
+#include <tuple>
+#include <vector>
+
 static void must_have(const std::string &out, const std::string &sub) {
     REQUIRE(out.find(sub) != std::string::npos);
 }
@@ -93,6 +101,69 @@ TEST_CASE("Aggregates, GROUP BY, HAVING, DISTINCT") {
     must_have(o, "a,3,");
 }
 
+TEST_CASE("Aggregates of many groups computed in a single pass") {
+    Database db;
+    db.process_query("CREATE TABLE g (k int, v int, n int);");
+
+    for(int i = 0; i < 100; ++i){
+        std::string values = std::to_string(i % 3) + ", " + std::to_string(i);
+
+        if(i % 10 == 0){
+            db.process_query("INSERT INTO g (k, v) VALUES (" + values + ");");
+        } else {
+            db.process_query("INSERT INTO g VALUES (" + values + ", " + std::to_string(i % 4) + ");");
+        }
+    }
+
+    auto o = db.process_query("SELECT k, COUNT(*), SUM(v), AVG(v), MIN(v), MAX(v), COUNT(n), COUNT(DISTINCT n) FROM g GROUP BY k;");
+    must_have(o, "0,34,1683,49,0,99,30,4,");
+    must_have(o, "1,33,1617,49,1,97,30,4,");
+    must_have(o, "2,33,1650,50,2,98,30,4,");
+
+    // expressions of aggregates and aggregates of expressions
+    o = db.process_query("SELECT k, SUM(v) - MIN(v) * 2, SUM(v + 1) FROM g GROUP BY k HAVING COUNT(*) > 33;");
+    must_have(o, "0,1683,1717,");
+    CHECK(std::ranges::count(o, '\n') - 2 == 1);
+
+    // distinct values of columns and expressions
+    o = db.process_query("SELECT k, SUM(DISTINCT n), AVG(DISTINCT v / 10), COUNT(DISTINCT v) FROM g WHERE n IS NOT NULL GROUP BY k;");
+    must_have(o, "0,6,4,30,");
+    must_have(o, "2,6,");
+
+    // a single group even without rows
+    o = db.process_query("SELECT COUNT(*), SUM(v) FROM g WHERE v > 1000;");
+    must_have(o, "0,\\x,");
+}
+
+TEST_CASE("String literals spelled like keywords, brackets or separators") {
+    Database db;
+    db.process_query("CREATE TABLE w (id int, s string);");
+
+    std::vector<std::string> literals = {"group", "having", ";", "(", ")", "and", "or", "between", "from", ",", "select", "not"};
+    for(size_t i = 0; i < literals.size(); ++i){
+        db.process_query("INSERT INTO w VALUES (" + std::to_string(i) + ", '" + literals[i] + "');");
+    }
+
+    for(size_t i = 0; i < literals.size(); ++i){
+        std::string id = std::to_string(i);
+        std::string literal = "'" + literals[i] + "'";
+
+        auto o = db.process_query("SELECT id FROM w WHERE s = " + literal + ";");
+        CHECK(o.ends_with("\n" + id + ",\n"));
+
+        o = db.process_query("SELECT id, " + literal + " FROM w WHERE id = " + id + " AND s = " + literal + ";");
+        std::string cell = literals[i] == "," ? "\\," : literals[i];
+        CHECK(o.ends_with("\n" + id + "," + cell + ",\n"));
+
+        // the conjuncts of a join condition
+        o = db.process_query("SELECT w.id FROM w, w x WHERE w.id = x.id AND x.s = " + literal + " AND w.id >= 0;");
+        CHECK(o.ends_with("\n" + id + ",\n"));
+
+        o = db.process_query("SELECT s, COUNT(*) FROM w GROUP BY s HAVING s = " + literal + ";");
+        CHECK(std::ranges::count(o, '\n') - 2 == 1);
+    }
+}
+
 TEST_CASE("Arithmetic expressions in SELECT and WHERE") {
     Database db;
     db.process_query("CREATE TABLE m (x int, y int);");
@@ -119,3 +190,148 @@ TEST_CASE("SELECT DISTINCT and multi-table cartesian join") {
     must_have(o, "1,2,");
 }
 
+
+TEST_CASE("SELECT DISTINCT keeps the first occurrences in order") {
+    Database db;
+    db.process_query("CREATE TABLE d (x int, s string);");
+
+    std::set<std::string> seen;
+    std::string expected;
+
+    for(int i = 0; i < 600; ++i){
+        std::string x = std::to_string(i % 37);
+        std::string s = "s" + std::to_string(i % 4);
+
+        if(i % 50 == 0){
+            db.process_query("INSERT INTO d (x) VALUES (" + x + ");");
+            s = "\\x";
+        } else {
+            db.process_query("INSERT INTO d VALUES (" + x + ", '" + s + "');");
+        }
+
+        std::string line = x + "," + s + ",\n";
+        if(seen.insert(line).second){
+            expected += line;
+        }
+    }
+
+    auto o = db.process_query("SELECT DISTINCT x, s FROM d;");
+    CHECK(o.ends_with("\n" + expected));
+
+    auto grouped = db.process_query("SELECT DISTINCT COUNT(*) FROM d GROUP BY x;");
+    CHECK(std::ranges::count(grouped, '\n') - 2 == 2);
+
+    // the seen rows are spilled to disk over the memory budget
+    auto spill_directory = std::filesystem::temp_directory_path() / "simpledb_distinct_test";
+    std::filesystem::create_directories(spill_directory);
+
+    ExecutionSettings settings;
+    settings.memory_budget = 0;
+    settings.spill_directory = spill_directory;
+    settings.batch_rows = 7;
+    db.set_settings(settings);
+
+    CHECK(db.process_query("SELECT DISTINCT x, s FROM d;") == o);
+    CHECK(db.process_query("SELECT DISTINCT COUNT(*) FROM d GROUP BY x;") == grouped);
+
+    // the temporary files are removed
+    CHECK(std::filesystem::is_empty(spill_directory));
+    std::filesystem::remove(spill_directory);
+}
+
+TEST_CASE("ORDER BY sorts by several keys in memory and on disk") {
+    Database db;
+    db.process_query("CREATE TABLE o (x int, s string);");
+
+    // rows as tuples (x, s, order of insertion), NULL is an empty optional
+    std::vector<std::tuple<int, std::optional<std::string>, int>> rows;
+
+    for(int i = 0; i < 300; ++i){
+        int x = i * 37 % 50;
+        std::string s = "s" + std::to_string(i % 5);
+
+        if(i % 9 == 0){
+            db.process_query("INSERT INTO o (x) VALUES (" + std::to_string(x) + ");");
+            rows.emplace_back(x, std::nullopt, i);
+        } else {
+            db.process_query("INSERT INTO o VALUES (" + std::to_string(x) + ", '" + s + "');");
+            rows.emplace_back(x, s, i);
+        }
+    }
+
+    auto to_lines = [](const auto& sorted, bool with_x){
+        std::string lines;
+        for(const auto& [x, s, i] : sorted){
+            lines += (with_x ? std::to_string(x) + "," : "") + s.value_or("\\x") + ",\n";
+        }
+        return lines;
+    };
+
+    // s descending with NULLs last, then x ascending
+    auto by_s_then_x = rows;
+    std::ranges::stable_sort(by_s_then_x, [](const auto& left, const auto& right){
+        const auto& [left_x, left_s, left_i] = left;
+        const auto& [right_x, right_s, right_i] = right;
+        if(left_s != right_s){
+            return left_s.has_value() && (!right_s.has_value() || left_s > right_s);
+        }
+        return left_x < right_x;
+    });
+
+    // x descending, an unselected key, ties in the order of insertion
+    auto by_x = rows;
+    std::ranges::stable_sort(by_x, std::greater<>(), [](const auto& row){ return std::get<0>(row); });
+
+    auto o1 = db.process_query("SELECT x, s FROM o ORDER BY s DESC NULLS LAST, x;");
+    CHECK(o1.ends_with("\n" + to_lines(by_s_then_x, true)));
+
+    auto o2 = db.process_query("SELECT s FROM o ORDER BY x DESC;");
+    CHECK(o2.ends_with("\n" + to_lines(by_x, false)));
+
+    auto o3 = db.process_query("SELECT DISTINCT s FROM o WHERE x < 40 ORDER BY s NULLS FIRST;");
+    CHECK(o3.ends_with("\n\\x,\ns0,\ns1,\ns2,\ns3,\ns4,\n"));
+
+    auto o4 = db.process_query("SELECT s, COUNT(*) FROM o GROUP BY s HAVING COUNT(*) > 40 ORDER BY COUNT(*) DESC, s;");
+    CHECK(std::ranges::count(o4, '\n') - 2 == 5);
+
+    CHECK(db.process_query("SELECT DISTINCT s FROM o ORDER BY x;").rfind("ERR", 0) == 0);
+
+    // over the memory budget sorted runs are written to disk and merged
+    auto spill_directory = std::filesystem::temp_directory_path() / "simpledb_sort_test";
+    std::filesystem::create_directories(spill_directory);
+
+    ExecutionSettings settings;
+    settings.memory_budget = 0;
+    settings.spill_directory = spill_directory;
+    settings.batch_rows = 7;
+    db.set_settings(settings);
+
+    CHECK(db.process_query("SELECT x, s FROM o ORDER BY s DESC NULLS LAST, x;") == o1);
+    CHECK(db.process_query("SELECT s FROM o ORDER BY x DESC;") == o2);
+    CHECK(db.process_query("SELECT DISTINCT s FROM o WHERE x < 40 ORDER BY s NULLS FIRST;") == o3);
+    CHECK(db.process_query("SELECT s, COUNT(*) FROM o GROUP BY s HAVING COUNT(*) > 40 ORDER BY COUNT(*) DESC, s;") == o4);
+
+    // string literals spelled like the words of ORDER BY are values
+    db.process_query("CREATE TABLE q (id int, s string);");
+    std::vector<std::string> literals = {"order", "desc", "nulls", ",", "asc", "by"};
+    for(size_t i = 0; i < literals.size(); ++i){
+        db.process_query("INSERT INTO q VALUES (" + std::to_string(i) + ", '" + literals[i] + "');");
+    }
+    for(size_t i = 0; i < literals.size(); ++i){
+        std::string literal = "'" + literals[i] + "'";
+
+        auto o = db.process_query("SELECT id FROM q WHERE s = " + literal + " ORDER BY id;");
+        CHECK(o.ends_with("\n" + std::to_string(i) + ",\n"));
+
+        o = db.process_query("SELECT id, " + literal + " FROM q WHERE id < 2 ORDER BY " + literal + ", id DESC;");
+        std::string cell = literals[i] == "," ? "\\," : literals[i];
+        CHECK(o.ends_with("\n1," + cell + ",\n0," + cell + ",\n"));
+    }
+
+    auto plan = db.process_query("EXPLAIN ANALYZE SELECT x FROM o ORDER BY x DESC;");
+    must_have(plan, "ExternalSort,x DESC,");
+
+    // the temporary files are removed
+    CHECK(std::filesystem::is_empty(spill_directory));
+    std::filesystem::remove(spill_directory);
+}
@@ -0,0 +1,242 @@
+#include "doctest.h"
+#include "db/database.h"
+#include "db/subquery.h"
+
+#include <algorithm>
+#include <atomic>
+
+static bool is_ok(const std::string &r)    { return r.rfind("OK ", 0) == 0; }
+static void must_have(const std::string &out, const std::string &sub) {
+    REQUIRE(out.find(sub) != std::string::npos);
+}
+static void must_not_have(const std::string &out, const std::string &sub) {
+    REQUIRE(out.find(sub) == std::string::npos);
+}
+
+static void fill_orders(Database& db){
+    db.process_query("CREATE TABLE customer(id INT, name STRING);");
+    db.process_query("CREATE TABLE orders(cid FLOAT, item STRING, qty INT);");
+
+    db.process_query("INSERT INTO customer VALUES (1, 'ann');");
+    db.process_query("INSERT INTO customer VALUES (2, 'ben');");
+    db.process_query("INSERT INTO customer VALUES (3, 'cid');");
+    db.process_query("INSERT INTO customer (name) VALUES ('dan');");
+
+    db.process_query("INSERT INTO orders VALUES (1, 'pen', 5);");
+    db.process_query("INSERT INTO orders VALUES (1, 'ink', 1);");
+    db.process_query("INSERT INTO orders VALUES (2, 'pad', 2);");
+    db.process_query("INSERT INTO orders (item, qty) VALUES ('box', 7);");
+}
+
+TEST_CASE("Correlated EXISTS and NOT EXISTS") {
+    Database db;
+    fill_orders(db);
+
+    auto out = db.process_query(
+        "SELECT name FROM customer c WHERE EXISTS (SELECT item FROM orders o WHERE o.cid = c.id);");
+    CHECK(is_ok(out));
+    must_have(out, "ann,");
+    must_have(out, "ben,");
+    must_not_have(out, "cid,");
+    must_not_have(out, "dan,");
+
+    out = db.process_query(
+        "SELECT name FROM customer c WHERE NOT EXISTS (SELECT * FROM orders o WHERE c.id = o.cid AND o.qty > 1);");
+    CHECK(is_ok(out));
+    must_not_have(out, "ann,");
+    must_not_have(out, "ben,");
+    must_have(out, "cid,");
+    must_have(out, "dan,");
+
+    // string literals inside the subquery survive the rewrite
+    out = db.process_query(
+        "SELECT name FROM customer c WHERE EXISTS (SELECT * FROM orders o WHERE o.cid = c.id AND o.item = 'ink');");
+    CHECK(is_ok(out));
+    must_have(out, "ann,");
+    must_not_have(out, "ben,");
+}
+
+TEST_CASE("Correlated IN, NOT IN and = ANY") {
+    Database db;
+    fill_orders(db);
+
+    auto out = db.process_query(
+        "SELECT name FROM customer c WHERE 5 IN (SELECT o.qty FROM orders o WHERE o.cid = c.id);");
+    CHECK(is_ok(out));
+    must_have(out, "ann,");
+    must_not_have(out, "ben,");
+
+    out = db.process_query(
+        "SELECT name FROM customer c WHERE 2 NOT IN (SELECT qty FROM orders o WHERE o.cid = c.id);");
+    CHECK(is_ok(out));
+    must_have(out, "ann,");
+    must_not_have(out, "ben,");
+    must_have(out, "cid,");
+    must_have(out, "dan,");
+
+    out = db.process_query(
+        "SELECT name FROM customer c WHERE 1 = ANY (SELECT qty FROM orders o WHERE o.cid = c.id);");
+    CHECK(is_ok(out));
+    must_have(out, "ann,");
+    must_not_have(out, "ben,");
+}
+
+TEST_CASE("Subqueries that can't be decorrelated") {
+    Database db;
+    fill_orders(db);
+
+    // correlated outside of an equality
+    auto out = db.process_query(
+        "SELECT name FROM customer c WHERE EXISTS (SELECT * FROM orders o WHERE o.cid = c.id AND o.qty > c.id * 2);");
+    CHECK(is_ok(out));
+    must_have(out, "ann,");
+    must_not_have(out, "ben,");
+
+    // aggregates return a row even when nothing matches
+    out = db.process_query(
+        "SELECT name FROM customer c WHERE EXISTS (SELECT COUNT(*) FROM orders o WHERE o.cid = c.id);");
+    CHECK(is_ok(out));
+    must_have(out, "cid,");
+    must_have(out, "dan,");
+
+    // ambiguous names are still reported
+    out = db.process_query(
+        "SELECT name FROM customer c WHERE EXISTS (SELECT * FROM customer x WHERE x.id = c.id AND name = 'ann');");
+    CHECK(!is_ok(out));
+}
+
+TEST_CASE("Uncorrelated subqueries") {
+    Database db;
+    fill_orders(db);
+
+    auto out = db.process_query("SELECT item FROM orders WHERE qty > (SELECT AVG(o.qty) FROM orders o);");
+    CHECK(is_ok(out));
+    must_have(out, "pen,");
+    must_have(out, "box,");
+    must_not_have(out, "pad,");
+
+    out = db.process_query("SELECT name FROM customer WHERE id IN (SELECT cid FROM orders o);");
+    CHECK(is_ok(out));
+    must_have(out, "ann,");
+    must_have(out, "ben,");
+    must_not_have(out, "cid,");
+
+    out = db.process_query("SELECT item FROM orders WHERE qty >= ALL (SELECT o.qty FROM orders o WHERE o.qty < 6);");
+    CHECK(is_ok(out));
+    must_have(out, "pen,");
+    must_have(out, "box,");
+    must_not_have(out, "ink,");
+
+    // ALL holds and ANY doesn't for an empty subquery
+    out = db.process_query("SELECT item FROM orders WHERE qty > ALL (SELECT o.qty FROM orders o WHERE o.qty > 100);");
+    must_have(out, "pen,");
+    must_have(out, "ink,");
+    out = db.process_query("SELECT item FROM orders WHERE qty > ANY (SELECT o.qty FROM orders o WHERE o.qty > 100);");
+    CHECK(std::ranges::count(out, '\n') - 2 == 0);
+
+    out = db.process_query("SELECT name FROM customer WHERE NOT EXISTS (SELECT * FROM orders o WHERE o.qty > 10);");
+    CHECK(is_ok(out));
+    must_have(out, "ann,");
+    must_have(out, "dan,");
+
+    // a scalar subquery returning several rows is still an error
+    CHECK(!is_ok(db.process_query("SELECT item FROM orders WHERE qty > (SELECT o.qty FROM orders o);")));
+}
+
+TEST_CASE("Correlated subquery results are cached by the outer values read") {
+    Table outer({{Cell::DataType::Int, "a"}, {Cell::DataType::Int, "b"}});
+    outer.add_row(std::vector<std::string>{"1", "10"});
+    outer.add_row(std::vector<std::string>{"1", "20"});
+    outer.add_row(std::vector<std::string>{"2", "30"});
+    outer.add_row(std::vector<std::string>{"1", "40"});
+
+    // rows may be evaluated on several threads
+    std::atomic<size_t> calls = 0;
+    SelectCallback callback = [&](TokenStream&, const VariableList& variables, SelectMode){
+        calls++;
+        Table result({{Cell::DataType::Int, "x"}});
+        result.add_row(std::vector<std::string>{variables.get_value("a").repr().value()});
+        return result;
+    };
+
+    VariableList variables;
+    Subquery subquery("SELECT a FROM t", outer, variables, callback);
+
+    SubqueryCache cache;
+    auto results = subquery.evaluate(cache);
+
+    CHECK(calls == 2);
+    CHECK(cache.hits() == 2);
+    CHECK(cache.misses() == 2);
+    CHECK(results.tables[0] == results.tables[1]);
+    CHECK(results.tables[0] == results.tables[3]);
+    CHECK(results.tables[0] != results.tables[2]);
+    CHECK(!results.shared);
+
+    // without room in the cache every row is evaluated
+    calls = 0;
+    SubqueryCache no_room(0);
+    subquery.evaluate(no_room);
+    CHECK(calls == 4);
+}
+
+TEST_CASE("Subquery results are shared between the parts of an outer table") {
+    Table first({{Cell::DataType::Int, "a"}});
+    first.add_row(std::vector<std::string>{"1"});
+    first.add_row(std::vector<std::string>{"2"});
+    Table second({{Cell::DataType::Int, "a"}});
+    second.add_row(std::vector<std::string>{"3"});
+
+    std::atomic<size_t> calls = 0;
+    SelectCallback callback = [&](TokenStream&, const VariableList&, SelectMode){
+        calls++;
+        Table result({{Cell::DataType::Int, "x"}});
+        result.add_row(std::vector<std::string>{"7"});
+        return result;
+    };
+
+    VariableList variables;
+    SubqueryCaches caches;
+
+    auto first_results = Subquery("SELECT x FROM t", first, variables, callback, &caches).evaluate();
+    auto second_results = Subquery("SELECT x FROM t", second, variables, callback, &caches).evaluate();
+
+    // the uncorrelated subquery runs once for both parts
+    CHECK(calls == 1);
+    CHECK(first_results.tables[0] == second_results.tables[0]);
+
+    // another statement has its own results
+    Subquery("SELECT y FROM t", second, variables, callback, &caches).evaluate();
+    CHECK(calls == 2);
+}
+
+TEST_CASE("EXISTS stops at the first matching row") {
+    Database db;
+    db.process_query("CREATE TABLE big(v INT);");
+    db.process_query("CREATE TABLE one(v INT);");
+    db.process_query("INSERT INTO one VALUES (1);");
+
+    for(int i = 0; i < 100; ++i){
+        db.process_query("INSERT INTO big VALUES (" + std::to_string(i) + ");");
+    }
+
+    auto out = db.process_query("SELECT v FROM one WHERE EXISTS (SELECT DISTINCT x.v FROM big x, big y WHERE x.v = 60 AND y.v > 90);");
+    CHECK(is_ok(out));
+    must_have(out, "1,");
+
+    out = db.process_query("SELECT v FROM one WHERE NOT EXISTS (SELECT * FROM big x, big y WHERE x.v + y.v > 198);");
+    CHECK(is_ok(out));
+    must_have(out, "1,");
+
+    // joined rows are neither projected, deduplicated nor sorted, the expressions would fail
+    out = db.process_query("SELECT v FROM one WHERE EXISTS (SELECT DISTINCT x.v - 'a' FROM big x, big y "
+        "WHERE x.v = y.v AND y.v > 50 ORDER BY x.v - 'a');");
+    CHECK(is_ok(out));
+    must_have(out, "1,");
+    CHECK(!is_ok(db.process_query("SELECT DISTINCT x.v - 'a' FROM big x, big y WHERE x.v = y.v AND y.v > 50;")));
+
+    // aggregates still produce their row
+    out = db.process_query("SELECT v FROM one WHERE EXISTS (SELECT MAX(x.v) FROM big x WHERE x.v > 1000);");
+    CHECK(is_ok(out));
+    must_have(out, "1,");
+}
@@ -2,6 +2,11 @@
 
 #include "db/table_serialization.h"
 #include "db/table.h"
+#include "db/join_algorithms.h"
+#include "db/table_index.h"
+#include "helper/row_container.h"
+#include "db/variable_list.h"
+#include <algorithm>
 #include <sstream>
 #include <vector>
 
@@ -66,3 +71,205 @@ TEST_CASE("Deserialize and serialize"){
     
     CHECK(out.str() == serialized);
 }
+
+TEST_CASE("Parts of a cross product"){
+    Table left({{Int, "a"}});
+    Table right({{Int, "b"}});
+    
+    for(int i = 0; i < 3; ++i){
+        left.add_row(std::vector<std::string>{std::to_string(i)});
+    }
+    for(int i = 0; i < 4; ++i){
+        right.add_row(std::vector<std::string>{std::to_string(i)});
+    }
+    
+    std::vector<std::pair<const Table&, std::string>> tables = {{left, "l"}, {right, "r"}};
+    
+    CHECK(Table::cross_product_size(tables) == 12);
+    
+    std::ostringstream full;
+    serialize_table(Table::cross_product(tables), full);
+    
+    // the parts put together give the full product
+    Table parts = Table::cross_product(tables, 0, 5);
+    parts.vertical_join(Table::cross_product(tables, 5, 5));
+    parts.vertical_join(Table::cross_product(tables, 10, 5));
+    
+    std::ostringstream joined;
+    serialize_table(parts, joined);
+    
+    CHECK(joined.str() == full.str());
+    
+    CHECK(Table::cross_product(tables, 12, 5).empty());
+    CHECK(!Table::cross_product(tables, 11, 5).empty());
+    
+    // tables already carrying their aliases keep them unambiguous
+    Table aliased_left(left.get_header().add_alias("l"), left.get_rows());
+    std::vector<std::pair<const Table&, std::string>> aliased = {{aliased_left, "l"}, {right, "r"}};
+    CHECK(Table::cross_product(aliased).get_header().get_column_info("l.a")->index == 0);
+}
+
+/**
+ * @brief Serialize the rows of a table in a canonical order
+ */
+static std::vector<std::string> sorted_rows(const Table& table){
+    std::ostringstream out;
+    serialize_table(table, out);
+    
+    std::vector<std::string> rows;
+    std::istringstream in(out.str());
+    for(std::string line; std::getline(in, line);){
+        rows.push_back(line);
+    }
+    
+    std::sort(rows.begin(), rows.end());
+    return rows;
+}
+
+static JoinKeys get_keys(const Table& table, const std::vector<size_t>& columns, const std::vector<Cell::DataType>& types){
+    JoinKeys keys;
+    for(const auto& row : table.get_rows()){
+        keys.push_back(make_typed_key(row, columns, types));
+    }
+    return keys;
+}
+
+/**
+ * @brief Put together the rows of the matching pairs
+ */
+static Table materialize(const Table& left, const Table& right, const JoinPairs& pairs){
+    std::vector<size_t> row_ids;
+    for(auto [left_row, right_row] : pairs){
+        row_ids.push_back(left_row);
+        row_ids.push_back(right_row);
+    }
+    return Table::combine_rows({&left, &right}, row_ids);
+}
+
+TEST_CASE("Join algorithms"){
+    Table left({{Int, "a"}, {Float, "b"}});
+    Table right({{Float, "c"}, {Int, "lo"}, {Int, "hi"}});
+    
+    for(int i = 0; i < 40; ++i){
+        std::map<std::string, std::string> row = {{"a", std::to_string(i % 9)}};
+        if(i % 5 != 0){
+            // the others are NULL
+            row["b"] = std::to_string(i % 4);
+        }
+        left.add_row(row);
+    }
+    for(int i = 0; i < 30; ++i){
+        right.add_row(std::vector<std::string>{std::to_string((i * 7) % 11), std::to_string(i % 6), std::to_string(i % 10)});
+    }
+    right.add_row(std::map<std::string, std::string>{{"hi", "3"}});
+    
+    std::vector<std::pair<const Table&, std::string>> tables = {{left, ""}, {right, ""}};
+    
+    auto filtered_product = [&](const std::string& condition){
+        Table product = Table::cross_product(tables);
+        TokenStream stream(condition);
+        product.filter_by_condition(stream, {}, {});
+        return product;
+    };
+    
+    JoinKeys left_keys = get_keys(left, {0, 1}, {Float, Float});
+    JoinKeys right_keys = get_keys(right, {0, 1}, {Float, Float});
+    
+    Table hashed = materialize(left, right, hash_join_pairs(left_keys, right_keys));
+    Table merged = materialize(left, right, merge_join_pairs(left_keys, right_keys));
+    
+    CHECK(!hashed.empty());
+    CHECK(sorted_rows(hashed) == sorted_rows(merged));
+    CHECK(sorted_rows(hashed) == sorted_rows(filtered_product("a = c AND b = lo")));
+    
+    KeyPartitions left_partitions(3, {Float, Float}, "");
+    KeyPartitions right_partitions(3, {Float, Float}, "");
+    for(size_t i = 0; i < left_keys.size(); ++i){
+        left_partitions.add(i, left_keys[i]);
+    }
+    for(size_t i = 0; i < right_keys.size(); ++i){
+        right_partitions.add(i, right_keys[i]);
+    }
+    
+    Table spilled = materialize(left, right, grace_hash_join_pairs(left_partitions, right_partitions));
+    CHECK(sorted_rows(hashed) == sorted_rows(spilled));
+    
+    Table banded = materialize(left, right, band_join_pairs(get_keys(left, {0}, {Int}), get_keys(right, {1, 2}, {Int, Int})));
+    
+    CHECK(!banded.empty());
+    CHECK(sorted_rows(banded) == sorted_rows(filtered_product("a BETWEEN lo AND hi")));
+    
+    // missing keys don't break the order
+    CHECK(!keys_sorted(get_keys(left, {0}, {Int})));
+    CHECK(keys_sorted({TableRow{Cell(std::string("1"), Int)}, std::nullopt, TableRow{Cell(std::string("2"), Int)}}));
+}
+
+TEST_CASE("Table indexes"){
+    Table table({{Int, "a"}, {String, "b"}});
+    
+    for(int i = 0; i < 20; ++i){
+        table.add_row(std::vector<std::string>{std::to_string(i % 5), "x" + std::to_string(i)});
+    }
+    table.add_row(std::map<std::string, std::string>{{"b", "null"}});
+    
+    auto hash = table.get_index(IndexKind::Hash, {0}, {Float});
+    auto ordered = table.get_index(IndexKind::Ordered, {0}, {Int});
+    
+    // kept until the table changes
+    CHECK(table.get_index(IndexKind::Hash, {0}, {Float}) == hash);
+    
+    std::vector<size_t> rows;
+    hash->find_equal({Cell(std::string("3"), Float)}, rows);
+    CHECK(rows == std::vector<size_t>{3, 8, 13, 18});
+    
+    rows.clear();
+    ordered->find_equal({Cell(std::string("3"), Int)}, rows);
+    CHECK(rows == std::vector<size_t>{3, 8, 13, 18});
+    
+    rows.clear();
+    ordered->find_range(Cell(std::string("1"), Int), Cell(std::string("2"), Int), rows);
+    CHECK(rows == std::vector<size_t>{1, 6, 11, 16, 2, 7, 12, 17});
+    
+    rows.clear();
+    ordered->find_range(Cell(std::string("2"), Int), Cell(std::string("1"), Int), rows);
+    CHECK(rows.empty());
+    
+    table.add_row(std::vector<std::string>{"3", "y"});
+    auto rebuilt = table.get_index(IndexKind::Hash, {0}, {Float});
+    CHECK(rebuilt != hash);
+    
+    rows.clear();
+    rebuilt->find_equal({Cell(std::string("3"), Float)}, rows);
+    CHECK(rows.size() == 5);
+    
+    // an index of an older version isn't given out
+    size_t version = table.get_version();
+    CHECK(table.get_index(IndexKind::Hash, {0}, {Float}, version) == rebuilt);
+    
+    table.add_row(std::vector<std::string>{"4", "z"});
+    CHECK(table.get_index(IndexKind::Hash, {0}, {Float}, version) == nullptr);
+    CHECK(table.get_index(IndexKind::Hash, {0}, {Float}, table.get_version()) != nullptr);
+}
+
+TEST_CASE("Column statistics"){
+    Table table({{Int, "a"}, {String, "b"}});
+    
+    for(int i = 0; i < 20; ++i){
+        table.add_row(std::vector<std::string>{std::to_string(i % 5), "x"});
+    }
+    table.add_row(std::map<std::string, std::string>{{"b", "y"}});
+    table.add_row(std::map<std::string, std::string>{{"b", "y"}});
+    
+    auto statistics = table.get_column_statistics(0);
+    CHECK(statistics.distinct_values == 5);
+    CHECK(statistics.non_null_fraction == doctest::Approx(20.0 / 22));
+    CHECK(table.get_column_statistics(1).distinct_values == 2);
+    
+    // kept until the table changes
+    size_t version = table.get_version();
+    CHECK(table.get_column_statistics(0, version).has_value());
+    
+    table.add_row(std::vector<std::string>{"7", "z"});
+    CHECK(!table.get_column_statistics(0, version).has_value());
+    CHECK(table.get_column_statistics(0, table.get_version())->distinct_values == 6);
+}
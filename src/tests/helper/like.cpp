@@ -0,0 +1,50 @@
+#include "doctest.h"
+
+#include "helper/like.h"
+
+TEST_CASE("LIKE patterns"){
+    struct Case{
+        std::string pattern;
+        std::string value;
+        bool expected;
+    };
+    
+    std::vector<Case> cases = {
+        {"abc", "abc", true},
+        {"abc", "abcd", false},
+        {"", "", true},
+        {"", "a", false},
+        {"ab%", "abc", true},
+        {"ab%", "ab", true},
+        {"ab%", "xab", false},
+        {"%bc", "abc", true},
+        {"%bc", "abcd", false},
+        {"%b%", "abc", true},
+        {"%b%", "ac", false},
+        {"%", "", true},
+        {"%%", "anything", true},
+        {"a_c", "abc", true},
+        {"a_c", "abbc", false},
+        {"a%c", "ac", true},
+        {"a%c", "abbbc", true},
+        {"a%c", "a", false},
+        {"ab%bc", "abc", false},
+        {"ab%bc", "abbc", true},
+        {"%a%b%", "xxaxxbxx", true},
+        {"%a%b%", "xxbxxaxx", false},
+        {"_%", "", false},
+        {"_%", "x", true},
+        {"%_b_%", "aab", false},
+        {"%_b_%", "abc", true},
+        {"a.c", "abc", false},
+        {"(x)*", "(x)*", true},
+    };
+    
+    for(auto&& [pattern, value, expected] : cases){
+        INFO(pattern, " ", value);
+        CHECK(is_like(value, pattern) == expected);
+        CHECK(LikePattern(pattern).matches(value) == expected);
+    }
+    
+    CHECK(LikePattern::get("a%") == LikePattern::get("a%"));
+}
@@ -0,0 +1,54 @@
+#include "doctest.h"
+#include "jobs/worker_pool.h"
+
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+
+TEST_CASE("WorkerPool covers every index exactly once"){
+    WorkerPool pool(3);
+    
+    std::vector<std::atomic<int>> visits(1000);
+    
+    pool.parallel_for(visits.size(), 7, [&](size_t begin, size_t end){
+        for(size_t i = begin; i < end; ++i){
+            visits[i]++;
+        }
+    });
+    
+    for(auto& count : visits){
+        CHECK(count == 1);
+    }
+}
+
+TEST_CASE("WorkerPool nested loops and exceptions"){
+    WorkerPool pool(2);
+    
+    std::atomic<size_t> total = 0;
+    
+    pool.parallel_for(10, 1, [&](size_t, size_t){
+        pool.parallel_for(10, 2, [&](size_t begin, size_t end){
+            total += end - begin;
+        });
+    });
+    
+    CHECK(total == 100);
+    
+    // the exception of the lowest range wins
+    auto failing = [&](){
+        pool.parallel_for(100, 1, [&](size_t begin, size_t){
+            if(begin % 10 == 3){
+                throw std::runtime_error(std::to_string(begin));
+            }
+        });
+    };
+    
+    CHECK_THROWS_WITH(failing(), "3");
+    
+    WorkerPool empty(0);
+    size_t sequential = 0;
+    empty.parallel_for(5, 2, [&](size_t begin, size_t end){
+        sequential += end - begin;
+    });
+    CHECK(sequential == 5);
+}
@@ -31,3 +31,19 @@ TEST_CASE("TokenStream"){
     DOCTEST_CHECK_EQ(stream.get_token(TokenType::String), "11");
     DOCTEST_CHECK_EQ(stream.empty(), true);
 }
+
+TEST_CASE("String literals are not keywords"){
+    TokenStream stream("group 'group' ( '('");
+
+    DOCTEST_CHECK(is_word(stream.peek_token(), "GROUP"));
+    DOCTEST_CHECK(stream.try_ignore_token("GROUP"));
+
+    DOCTEST_CHECK_FALSE(is_word(stream.peek_token(), "GROUP"));
+    DOCTEST_CHECK_FALSE(stream.try_ignore_token("GROUP"));
+    DOCTEST_CHECK_THROWS_AS(stream.ignore_token("GROUP"), InvalidQuery);
+    DOCTEST_CHECK_EQ(stream.get_token(TokenType::String), "group");
+
+    stream.ignore_token("(");
+    DOCTEST_CHECK_FALSE(stream.try_ignore_token("("));
+    DOCTEST_CHECK_EQ(stream.get_token(TokenType::String), "(");
+}